@@ -3,10 +3,35 @@
 #include <string>
 #include <cstring>
 #include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <time.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
 #include <assert.h>
 #include <bits/stdc++.h>
+#include "ChessEngine.h"
 
 /*----------------------------------*/
 /*             Bitboard             */
@@ -162,7 +187,10 @@ void printBitBoard(Bitboard board){
 /*          RANDOM NUMBERS          */
 /*----------------------------------*/
 
-unsigned int randNum = 1804289383;
+// seed of the random number generator, fixed so the zobrist keys are identical between runs
+#define RANDOM_SEED 1804289383
+
+unsigned int randNum = RANDOM_SEED;
 
 // 32 bit random number generator
 unsigned int random32(){
@@ -204,7 +232,7 @@ Bitboard castle_keys[16];
 Bitboard side_key;
 
 void init_random_keys(){
-    randNum = 1804289383;
+    randNum = RANDOM_SEED;
 
     for(int i = 0; i < 12; i++){
         for(int j = 0; j < 64; j++){
@@ -229,127 +257,87 @@ void init_random_keys(){
 
 // BlueFeverSoftware implementation
 
-bool quit = false;
+// set by the input thread once stdin is closed or the GUI sent "quit"
+std::atomic<bool> quit(false);
 
-// UCI movestogo move counter
-int movestogo = 30;
+// moves the remaining time is spread over when the GUI sends no movestogo
+const int default_moves_to_go = 30;
 
-// UCI movetime command time counter
-int movetime = -1;
+// the hard limit may use up to this many soft allotments
+const int hard_time_multiplier = 5;
 
-// UCI time command holder (ms)
-int timeTracker = -1;
+// Gets ms elapsed on a monotonic clock since the first call
+int get_time_ms(){
+#ifdef _WIN32
+    static const long long epoch = GetTickCount64();
 
-// UCI inc command's time increment holder
-int inc = 0;
+    return (int)(GetTickCount64() - epoch);
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-//UCI starttime command time holder
-int starttime = 0;
+    long long ms = (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    static const long long epoch = ms;
 
-// UCI stoptime command time holder
-int stoptime = 0;
+    return (int)(ms - epoch);
+#endif
+}
 
-// variable to flag time control availability
-bool timeset = false;
+/*----------------------------------*/
+/*               INPUT              */
+/*----------------------------------*/
 
-// variable to flag when the time is up
-bool stopped = false;
+// lines read from stdin that are waiting for the UCI loop
+std::deque<std::string> input_queue;
+std::mutex input_mutex;
+std::condition_variable input_available;
 
-// Gets current ms time
-int get_time_ms(){
-    return GetTickCount();
-}
+// reads GUI/user input on its own thread so neither the search nor the UCI loop polls stdin
+void inputThread(){
+    std::string line;
 
-int input_waiting(){
-    static int init = 0, pipe;
-    static HANDLE inh;
-    DWORD dw;
+    while(true){
+        bool eof = !std::getline(std::cin, line);
 
-    if (!init)
-    {
-        init = 1;
-        inh = GetStdHandle(STD_INPUT_HANDLE);
-        pipe = !GetConsoleMode(inh, &dw);
-        if (!pipe)
-        {
-            SetConsoleMode(inh, dw & ~(ENABLE_MOUSE_INPUT|ENABLE_WINDOW_INPUT));
-            FlushConsoleInputBuffer(inh);
+        // a closed stdin means the GUI is gone
+        if(eof){
+            line = "quit";
         }
-    }
-    
-    if (pipe)
-    {
-        if (!PeekNamedPipe(inh, NULL, 0, NULL, &dw, NULL)) return 1;
-        return dw;
-    }
-    
-    else
-    {
-        GetNumberOfConsoleInputEvents(inh, &dw);
-        return dw <= 1 ? 0 : dw;
-    }
-}
 
-// read GUI/user input
-void read_input()
-{
-    // bytes to read holder
-    int bytes;
-    
-    // GUI/user input
-    char input[256] = "", *endc;
+        if(!line.empty() && line.back() == '\r'){
+            line.pop_back();
+        }
 
-    // "listen" to STDIN
-    if (input_waiting())
-    {
-        // tell engine to stop calculating
-        stopped = true;
-        
-        // loop to read bytes from STDIN
-        do
-        {
-            // read bytes from STDIN
-            bytes=read(fileno(stdin), input, 256);
+        if(strncmp(line.c_str(), "quit", 4) == 0){
+            quit = true;
         }
-        
-        // until bytes available
-        while (bytes < 0);
-        
-        // searches for the first occurrence of '\n'
-        endc = strchr(input,'\n');
-        
-        // if found new line set value at pointer to 0
-        if (endc) *endc=0;
-        
-        // if input is available
-        if (strlen(input) > 0)
+
         {
-            // match UCI "quit" command
-            if (!strncmp(input, "quit", 4))
-            {
-                // tell engine to terminate exacution    
-                quit = true;
-            }
+            std::lock_guard<std::mutex> lock(input_mutex);
+            input_queue.push_back(line);
+        }
 
-            // // match UCI "stop" command
-            else if (!strncmp(input, "stop", 4))    {
-                // tell engine to terminate exacution
-                quit = true;
-            }
-        }   
+        input_available.notify_one();
+
+        if(quit){
+            return;
+        }
     }
 }
 
-// a bridge function to interact between search and GUI input
-static void communicate() {
-	// if time is up break here
-    if(timeset && get_time_ms() > stoptime) {
-		// tell engine to stop calculating
-		stopped = true;
-	}
-	
-    // read GUI input
-	read_input();
+void startInputThread(){
+    std::thread(inputThread).detach();
+}
+
+// blocks until the input thread has a line for the UCI loop
+std::string nextInputLine(){
+    std::unique_lock<std::mutex> lock(input_mutex);
+    input_available.wait(lock, []{ return !input_queue.empty(); });
+
+    std::string line = input_queue.front();
+    input_queue.pop_front();
+
+    return line;
 }
 
 /*----------------------------------*/
@@ -881,8 +869,19 @@ class Move{
         return this->from == m.from && this->to == m.to && this->piece == m.piece && this->promotedPiece == m.promotedPiece && this->flags == m.flags;
     }
 
+    // UCI notation, e.g. e2e4 or a7a8q
+    std::string toString(){
+        std::string uci = toSquare[from] + toSquare[to];
+
+        if(promotedPiece){
+            uci += piecePromotion.at(promotedPiece);
+        }
+
+        return uci;
+    }
+
     void print(){
-        std::cout << toSquare[from] << toSquare[to] << piecePromotion[promotedPiece];
+        std::cout << toString();
     }
 };
 
@@ -991,9 +990,13 @@ class Chessboard{
         int index = 0;
         while(square < numSquares){
             if(isalpha(fen[index])){
-                int piece = charToPiece[fen[index]];
+                // find rather than operator[] so concurrent parsing never writes to the shared map
+                auto piece = charToPiece.find(fen[index]);
+
+                if(piece != charToPiece.end()){
+                    pieceBoards[piece->second] |= sqr[square];
+                }
 
-                pieceBoards[piece] |= sqr[square];
                 square++;
             }else if(isdigit(fen[index])){
                 square += (fen[index] - '0');
@@ -1455,11 +1458,19 @@ const int castling_rights[64] = {
     13, 15, 15, 15, 12, 15, 15, 14,
 };
 
+class HashTable;
+
+// issues a prefetch of the transposition table slot for a key (defined with the table)
+static inline void prefetchHashEntry(const HashTable *table, Bitboard hashKey);
+
 class BoardContainer{
     public:
     Chessboard board;
     Chessboard copy;
 
+    // table of the search playing moves on this board, prefetched into by makeMove
+    HashTable *table = NULL;
+
     BoardContainer(){
         board = Chessboard();
         copy = Chessboard();
@@ -1612,6 +1623,11 @@ class BoardContainer{
 
             board.hashKey ^= side_key;
 
+            // the child's key is final, start loading its table slot while legality is checked
+            if(table){
+                prefetchHashEntry(table, board.hashKey);
+            }
+
             if(board.isAttacked(!isWhite ? findLSB(board.pieceBoards[k]):findLSB(board.pieceBoards[K]), board.side)){
                 restoreBoard();
 
@@ -2060,852 +2076,4439 @@ static int mvv_lva[12][12] = {
 // max ply
 constexpr int MAX_PLY = 64;
 
-// killer moves [id][ply]
-Move killer_moves[2][MAX_PLY];
+// bound for history scores, the gravity update keeps every entry within [-history_max, history_max]
+constexpr int history_max = 2000;
 
-// history moves [piece][square]
-int history_moves[12][64] = {0};
+// most lines a MultiPV search reports
+constexpr int MAX_MULTIPV = 64;
 
-// PV length [ply]
-int pv_length[MAX_PLY];
-
-// PV table [ply][ply]
-Move pv_table[MAX_PLY][MAX_PLY];
+// Class to track a legal root move across iterative deepening iterations
+class RootMove{
+    public:
+    Move move;
 
-// follow PV and score PV move
-int follow_pv, score_pv;
+    // score of the move in the current iteration, -infinity if it never raised alpha
+    int score = -infinity;
 
-// depth tracker from current node for search
-int ply = 0;
-unsigned long long nodes = 0;
+    // nodes spent in the move's subtree during the current iteration
+    unsigned long long nodes = 0;
 
-/*----------------------------------*/
-/*      TRANSPOSITION TABLES        */
-/*----------------------------------*/
+    RootMove(){
+        move = Move();
+        score = -infinity;
+        nodes = 0;
+    }
 
-// hash table size
-#define HASH_SIZE 800000
+    RootMove(Move move){
+        this->move = move;
+        score = -infinity;
+        nodes = 0;
+    }
+};
 
-#define NOT_FOUND 100000
+// proof or disproof number of a goal that can no longer be reached
+constexpr int proof_infinity = 100000000;
 
-// hash flags for transposition table implementation
-#define hashFlagExact 0 // PV node (score > alpha)
-#define hashFlagAlpha 1 // fail low(score <= alpha)
-#define hashFlagBeta 2  // fail high(score >= beta)
+// entries of the mate solver's table, about 24 MB
+#define PROOF_TABLE_ENTRIES (1 << 20)
 
-class transpositionTable{
+// Class to store the proof and disproof numbers of a position of the mate solver, from the mating side's point of view
+class ProofEntry{
     public:
-    Bitboard hashKey = 0ULL;
-    int depth = 0;
-    int hashFlag = 0;   // flag the type of node
-    int score = 0;
+    Bitboard key = 0;
 
-    transpositionTable(){
-        hashKey = 0ULL;
-        depth = 0;
-        hashFlag = 0;
-        score = 0;
-    }
+    // plies left to deliver mate, -1 for an empty entry
+    int plies = -1;
+
+    // moves of the mating side still to prove mate / moves of the defender still to refute it, 0 once solved
+    int proof = 1;
+    int disproof = 1;
 };
 
-transpositionTable hashTable[HASH_SIZE];
+// Counters of the search, only collected when built with -DSEARCH_STATISTICS ("make stats") so that
+// normal builds pay nothing for them
+#ifdef SEARCH_STATISTICS
+#define STAT(counter) (stats.counter++)
+#else
+#define STAT(counter)
+#endif
 
-void clearHashTable(){
-    for(int index = 0; index < HASH_SIZE; index++){
-        hashTable[index].hashKey = 0ULL;
-        hashTable[index].depth = 0;
-        hashTable[index].hashFlag = 0;
-        hashTable[index].score = 0;
-    }
-}
+class SearchStats{
+    public:
+    // transposition table probes in the main search, those that found the position, and those that cut the node
+    unsigned long long tt_probes = 0, tt_hits = 0, tt_cutoffs = 0;
 
-static inline int readHashEntry(int alpha, int beta, int depth, Bitboard hashKey){
-    transpositionTable *hashEntry = &hashTable[hashKey % HASH_SIZE];
+    // beta cutoffs of the main search, and those caused by the first move searched
+    unsigned long long fail_highs = 0, first_move_fail_highs = 0;
 
-    // if table entry matches current position
-    if(hashEntry->hashKey == hashKey){
-        if(hashEntry->depth >= depth){
-            int score = hashEntry->score;
+    // nodes of the main search and of quiescence
+    unsigned long long main_nodes = 0, quiescence_nodes = 0;
 
-            if(score < -mate_score){
-                score += ply;
-            }
+    // null move searches and those that cut the node
+    unsigned long long null_tries = 0, null_cutoffs = 0;
 
-            if(score > mate_score){
-                score -= ply;
-            }
+    // reduced searches and those that had to be re-searched at full depth
+    unsigned long long lmr_tries = 0, lmr_researches = 0;
 
-            // match PV node score
-            if(hashEntry->hashFlag == hashFlagExact){
-                return score;
-            }
+    // zero window searches and those re-searched with the full window
+    unsigned long long pvs_tries = 0, pvs_researches = 0;
 
-            // match fail-low score
-            if((hashEntry->hashFlag == hashFlagAlpha) && (score <= alpha)){
-                return alpha;
-            }
+    // nodes of every completed iteration [depth]
+    unsigned long long depth_nodes[MAX_PLY + 1] = {0};
+    int last_depth = 0;
 
-            // match fail-high score
-            if((hashEntry->hashFlag == hashFlagBeta) && (score >= beta)){
-                return beta;
-            }
-        }
+    // percentage of part in total
+    static double rate(unsigned long long part, unsigned long long total){
+        return total ? 100.0 * part / total:0.0;
     }
 
-    return NOT_FOUND;
-}
+    // effective branching factor of an iteration, nodes of the iteration over nodes of the previous one
+    double branchingFactor(int depth) const{
+        return (depth > 1 && depth_nodes[depth - 1]) ? (double)depth_nodes[depth] / depth_nodes[depth - 1]:0.0;
+    }
 
-static inline void storeHashEntry(int score, int depth, int hashFlag, Bitboard hashKey){
-    transpositionTable *hashEntry = &hashTable[hashKey % HASH_SIZE];
+    // one line summary for "info string"
+    std::string summary() const{
+        char line[512];
 
-    if(score < -mate_score){
-        score -= ply;
-    }
+        snprintf(line, sizeof(line), "tt hit %.1f%% cut %.1f%% first move fail-high %.1f%% qnodes %.1f%% null cut %.1f%% "
+            "lmr re-search %.1f%% pvs re-search %.1f%% ebf %.2f",
+            rate(tt_hits, tt_probes), rate(tt_cutoffs, tt_probes), rate(first_move_fail_highs, fail_highs),
+            rate(quiescence_nodes, main_nodes + quiescence_nodes), rate(null_cutoffs, null_tries),
+            rate(lmr_researches, lmr_tries), rate(pvs_researches, pvs_tries), branchingFactor(last_depth));
 
-    if(score > mate_score){
-        score += ply;
+        return line;
     }
+};
 
-    hashEntry->hashKey = hashKey;
-    hashEntry->depth = depth;
-    hashEntry->hashFlag = hashFlag;
-    hashEntry->score = score;
-}
+class CoreScheduler;
+class SearchTracer;
 
-/*----------------------------------*/
-/*        MOVE SCORE/ORDERING       */
-/*----------------------------------*/
+// State of one search, every engine instance owns its own so searches on different threads never share anything
+// but the read-only lookup tables
+class Searcher{
+    public:
+    // transposition table used by the search, owned by the engine
+    HashTable *table = NULL;
 
-// enable PV move scoring
-static inline void enablePVScoring(MoveList move_list){
-    // clear follow pv flag
-    follow_pv = 0;
+    // killer moves [id][ply]
+    Move killer_moves[2][MAX_PLY];
 
-    // loop over the moves within move list
-    for(int count = 0; count < move_list.count; count++){
-        // match with current pv move
-        if(pv_table[0][ply] == move_list.moves[count]){
-            // set pv flags
-            score_pv = 1;
-            follow_pv = 1;
-        }
-    }
-}
+    // history moves [piece][square]
+    int history_moves[12][64] = {{0}};
 
-// Scores a move based off of mvv lva lookup table
-static inline int scoreMove(Move move, BoardContainer boards){
-    // pv move scoring
-    if(score_pv){
-        // check if move matches pv move
-        if(pv_table[0][ply] == move){
-            // clear score pv flag
-            score_pv = 0;
+    // countermoves [previous piece][previous target square], the quiet move that last refuted the previous move
+    Move counter_moves[12][64];
 
-            return 20000;
-        }
-    }
+    // continuation history [previous piece][previous target square][piece][square], shared by the 1 and 2 ply continuations
+    int continuation_history[12][64][12][64] = {{{{0}}}};
 
-    if(move.flags & CAPTURE){ // Score captures
-        int target = P;
+    // moves played to reach each ply [ply], empty for the root and null moves
+    Move played_moves[MAX_PLY + 1];
 
-        int startInd, endInd;
-        if(boards.board.side == White){
-            startInd = p;
-            endInd = k;
-        }else{
-            startInd = P;
-            endInd = K;
-        }
+    // PV length [ply]
+    int pv_length[MAX_PLY] = {0};
 
-        for(int piece = startInd; piece <= endInd; piece++){
-            if(getSquare(boards.board.pieceBoards[piece], move.to)){
-                target = piece;
-                break;
-            }
-        }
-        
-        return mvv_lva[move.piece][target] + 10000;
-    }else{ // Score quiet moves
-        if(killer_moves[0][ply] == move){
-            return 9000;
-        }else if(killer_moves[1][ply] == move){
-            return 8000;
-        }else{
-            return history_moves[move.piece][move.to];
-        }
-    }
-    return 0;
-}
+    // PV table [ply][ply]
+    Move pv_table[MAX_PLY][MAX_PLY];
 
-// prints all move scores
-void printMoveScores(MoveList move_list, BoardContainer boards){
-    std::cout << "Move Scores\n\n";
-    for(int ind = 0; ind < move_list.count; ind++){
-        std::cout << "Move: ";
-        move_list.moves[ind].print();
-        std::cout << " Score: " << scoreMove(move_list.moves[ind], boards) << std::endl;
-    }
-}
+    // follow PV and score PV move
+    int follow_pv = 0, score_pv = 0;
 
-// sort moves in descending order
-static inline int sortMoves(MoveList &move_list, BoardContainer boards){
-    int moveScores[move_list.count];
-    
-    for (int ind = 0; ind < move_list.count; ind++){
-        moveScores[ind] = scoreMove(move_list.moves[ind], boards);
-    }
-    
-    for (int ind = 0; ind < move_list.count; ind++)    {
-        for (int nextInd = ind + 1; nextInd < move_list.count; nextInd++)
-        {
-            // compare current and next move scores
-            if (moveScores[ind] < moveScores[nextInd])
-            {
-                // swap scores
-                int temp_score = moveScores[ind];
-                moveScores[ind] = moveScores[nextInd];
-                moveScores[nextInd] = temp_score;
-                
-                // swap moves
-                Move temp_move = move_list.moves[ind];
-                move_list.moves[ind] = move_list.moves[nextInd];
-                move_list.moves[nextInd] = temp_move;
-            }
-        }
-    }
+    // depth tracker from current node for search
+    int ply = 0;
+    unsigned long long nodes = 0;
 
-    return 0;
-}
+    // legal root moves, kept in the order they are searched (previous iteration's best first)
+    RootMove root_moves[256];
+    int root_move_count = 0;
 
-/*----------------------------------*/
-/*              SEARCH              */
-/*----------------------------------*/
+    // "searchmoves" restriction in UCI notation, empty to search every legal move
+    std::vector<std::string> search_moves;
 
-static inline bool is_repeated(BoardContainer boards){
-    for(int count = 0; count < boards.board.rep_ind; count++){
-        if(boards.board.repetition_table[count] == boards.board.hashKey){
-            return true;
-        }
-    }
+    // number of lines to search, and the line being searched, root moves before it belong to better lines
+    int multipv = 1;
+    int multipv_index = 0;
 
-    return false;
-}
+    // score and pv of each line in the last completed iteration, for its aspiration window and pv ordering
+    int multipv_scores[MAX_MULTIPV] = {0};
+    Move multipv_pv[MAX_MULTIPV][MAX_PLY];
 
-// quiescence search
-static inline int quiescence(int alpha, int beta, BoardContainer boards){
-    // Check gui input every 2047 nodes
-    if((nodes & 2047) == 0){
-        communicate();
-    }
-    
-    nodes++;
+    // movestogo move counter, 0 if the GUI did not send one
+    int movestogo = 0;
 
-    if(ply > MAX_PLY - 1){
-        return evaluate(boards);
-    }
+    // movetime time counter
+    int movetime = -1;
 
-    int eval = evaluate(boards);
+    // node limit, 0 for none
+    unsigned long long node_limit = 0;
 
-    // fail hard beta cutoff, node fails high
-    if(eval >= beta){
-        return beta;
-    }
+    // counters of the current search, all zero unless built with SEARCH_STATISTICS
+    SearchStats stats;
 
-    // fount a better move
-    if(eval > alpha){
-        // PV node
-        alpha = eval;
-    }
+    // records sampled subtrees of the search, NULL when tracing is off
+    SearchTracer *tracer = NULL;
 
-    MoveList move_list;
+    // id of the sampled subtree being recorded, 0 outside of one, and the number of traced nodes on the stack
+    unsigned int trace_subtree = 0;
+    int trace_level = 0;
 
-    boards.board.generateMoves(move_list);
+    // moves of a "go mate" search, 0 for a normal search
+    int mate_moves = 0;
 
-    sortMoves(move_list, boards);
+    // side looking for the mate, and the mate solver's table, allocated by the first mate search
+    int mate_side = White;
+    std::vector<ProofEntry> proof_table;
 
-    for(int ind = 0; ind < move_list.count; ind++){
-        boards.saveBoard();
+    // remaining time of the side to move (ms)
+    int timeTracker = -1;
 
-        ply++;
+    // time increment of the side to move
+    int inc = 0;
 
-        boards.board.repetition_table[boards.board.rep_ind] = boards.board.hashKey;
-        boards.board.rep_ind++;
+    // start of the search, moved to "ponderhit" when pondering
+    std::atomic<int> starttime{0};
 
-        if(boards.makeMove(move_list.moves[ind], captures) == 0){
-            ply--;
+    // hard limit at which a running iteration is aborted
+    std::atomic<int> stoptime{0};
 
-            boards.board.rep_ind--;
+    // soft limit after which no new iteration is started, scaled by the search's confidence
+    std::atomic<int> soft_stoptime{0};
 
-            continue;
-        }
+    // variable to flag time control availability
+    bool timeset = false;
 
-        int score = -quiescence(-beta, -alpha, boards);
+    // ms reserved per move for GUI and network latency
+    int move_overhead = 50;
 
-        ply--;
+    // variable to flag when the time is up or a stop was requested, written by other threads during a search
+    std::atomic<bool> stopped{false};
 
-        boards.board.rep_ind--;
+    // set during a ponder search until "ponderhit", the clock is ignored while it is set
+    std::atomic<bool> pondering{false};
 
-        boards.restoreBoard();
+    // called after every completed iteration, may be empty
+    std::function<void(const SearchInfo &)> info_callback;
+
+    // cores shared with the searches of other sessions in server mode, NULL if the search has its own core
+    CoreScheduler *scheduler = NULL;
+
+    // whether the search holds one of the scheduler's cores, and since when
+    bool holding_core = false;
+    int slice_start = 0;
+
+    Searcher(HashTable *table){
+        this->table = table;
+    }
+
+    void communicate();
+    void waitForCore();
+    void yieldCore();
+    void releaseCore();
+    void setLimits(const SearchLimits &limits, int side);
+    void setTimeLimits();
+    bool timeForNextIteration(int iteration_time, double branching_factor, int stable_iterations, int score_drop);
+    void ponderHit();
+
+    void enablePVScoring(MoveList move_list);
+    int scoreMove(Move move, BoardContainer boards, Move hashMove = Move());
+    void updateQuietHeuristics(Move move, int depth, Move *quiets, int quiet_count);
+    void ageHistory();
+    void clearHistory();
+    void printMoveScores(MoveList move_list, BoardContainer boards);
+    int sortMoves(MoveList &move_list, BoardContainer boards, Move hashMove = Move());
+
+    int quiescence(int alpha, int beta, BoardContainer boards);
+    int negamax(int alpha, int beta, int depth, BoardContainer boards, Move excludedMove = Move());
+    void initRootMoves(BoardContainer boards);
+    void sortRootMoves(int first, Move best);
+    SearchInfo lineInfo(int depth, int score);
+    SearchResult searchPosition(int depth, BoardContainer boards);
+
+    void probeProof(Bitboard key, int plies, int &proof, int &disproof);
+    void storeProof(Bitboard key, int plies, int proof, int disproof);
+    void proofSearch(BoardContainer boards, int plies, int proof_threshold, int disproof_threshold);
+    bool proveMate(BoardContainer boards, int plies);
+    void mateLine(BoardContainer boards, int plies, std::vector<std::string> &line);
+    SearchResult solveMate(BoardContainer boards);
+};
+
+// ms a search may keep a shared core while other searches wait for one
+const int core_time_slice = 20;
+
+// a bridge function between search and the clock, GUI input is handled by the input thread
+inline void Searcher::communicate() {
+	// if time is up break here
+    if(timeset && !pondering && get_time_ms() > stoptime) {
+		// tell engine to stop calculating
+		stopped = true;
+	}
+
+    // node limit, checked at the same granularity as the clock
+    if(node_limit && nodes >= node_limit){
+        stopped = true;
+    }
+
+    // take turns with the waiting searches of other sessions
+    if(holding_core && get_time_ms() - slice_start >= core_time_slice){
+        yieldCore();
+    }
+}
+
+// takes over the limits of a search starting now, side picks the clock of the side to move
+void Searcher::setLimits(const SearchLimits &limits, int side){
+    movestogo = limits.movestogo;
+    movetime = limits.movetime;
+    node_limit = limits.nodes;
+    mate_moves = std::max(0, std::min(limits.mate, MAX_PLY / 2));
+    timeTracker = (side == White) ? limits.wtime:limits.btime;
+    inc = (side == White) ? limits.winc:limits.binc;
+
+    // timing is set up as usual for a ponder search but only applies after "ponderhit"
+    pondering = limits.ponder;
+
+    search_moves = limits.searchmoves;
+
+    multipv = std::max(1, std::min(limits.multipv, MAX_MULTIPV));
+
+    starttime = get_time_ms();
+
+    setTimeLimits();
+}
+
+// sets the soft and hard limits of a search starting now
+void Searcher::setTimeLimits(){
+    timeset = false;
+
+    int soft, hard;
+
+    if(movetime != -1){
+        // fixed time per move, both limits are the same
+        soft = hard = std::max(movetime - move_overhead, 1);
+    }else if(timeTracker != -1){
+        int horizon = movestogo ? std::min(movestogo, default_moves_to_go):default_moves_to_go;
+        int remaining = std::max(timeTracker - move_overhead, 1);
+
+        soft = remaining / horizon + inc * 3 / 4;
+        hard = (horizon == 1) ? remaining:std::min(soft * hard_time_multiplier, remaining / 2);
+        soft = std::min(soft, hard);
+    }else{
+        return;
+    }
+
+    timeset = true;
+    soft_stoptime = starttime + soft;
+    stoptime = starttime + hard;
+}
+
+// decides after a completed iteration whether the next one is worth starting
+// iteration_time and branching_factor come from the iteration that just finished
+bool Searcher::timeForNextIteration(int iteration_time, double branching_factor, int stable_iterations, int score_drop){
+    int elapsed = get_time_ms() - starttime;
+
+    // spend longer when the best move just changed or the score is falling, less when the best move is settled
+    int scale = 100;
+
+    if(stable_iterations == 0){
+        scale += 40;
+    }else if(stable_iterations >= 3){
+        scale -= 25;
+    }
+
+    if(score_drop > 0){
+        scale += std::min(score_drop, 100);
+    }
+
+    if(elapsed >= (soft_stoptime - starttime) * scale / 100){
+        return false;
+    }
+
+    // an iteration predicted to run past the hard limit would be aborted and thrown away
+    return elapsed + iteration_time * branching_factor <= stoptime - starttime;
+}
+
+// the opponent played the expected move, the ponder search continues as a normal timed search from now
+void Searcher::ponderHit(){
+    int now = get_time_ms();
+
+    stoptime = now + (stoptime - starttime);
+    soft_stoptime = now + (soft_stoptime - starttime);
+    starttime = now;
+    pondering = false;
+}
+
+/*----------------------------------*/
+/*          SEARCH TRACING          */
+/*----------------------------------*/
+
+// Records nodes of negamax and quiescence into a ring buffer that is written to a file after every search.
+// One node in trace_sample starts a sampled subtree and every node below it is recorded, so whole subtrees
+// can be rebuilt offline ("ChessEngine trace <file>") while the rest of the search runs at full speed.
+
+// records kept per search, 32 MB, older records are overwritten
+#define TRACE_RING_RECORDS (1 << 20)
+
+// how a traced node returned
+enum {
+    trace_none, trace_repetition, trace_tt_cutoff, trace_quiescence, trace_horizon, trace_null_cutoff, trace_multi_cut,
+    trace_beta_cutoff, trace_fail_low, trace_exact, trace_mate, trace_stalemate, trace_stand_pat, trace_stopped, trace_reason_count
+};
+
+static const char *trace_reason_names[trace_reason_count] = {
+    "none", "repetition", "tt cutoff", "quiescence", "horizon", "null cutoff", "multi-cut",
+    "beta cutoff", "fail low", "exact", "mate", "stalemate", "stand pat", "stopped"
+};
+
+// node flags of a record
+#define TRACE_QUIESCENCE 1
+#define TRACE_TT_HIT 2
+#define TRACE_EXCLUDED 4
+
+// A traced node, written when it returns, so a subtree's nodes come before its root
+class TraceRecord{
+    public:
+    uint64_t key;
+
+    // window the node was searched with and the score it returned
+    int32_t alpha, beta, score;
+
+    // sampled subtree the node belongs to
+    uint32_t subtree;
+
+    // move leading to the node, from | to << 6 | promoted piece << 12, 0 for the root and null moves
+    uint16_t move;
+
+    uint8_t ply;
+
+    // number of traced ancestors, nested searches at the same ply (singular verification,
+    // quiescence at the horizon) are one level deeper than the node that started them
+    uint8_t level;
+
+    int8_t depth;
+    uint8_t flags;
+    uint8_t reason;
+    uint8_t unused = 0;
+};
+
+static_assert(sizeof(TraceRecord) == 32, "trace records are written to disk as they are");
+
+// Header of a trace file, followed by count records, oldest first
+class TraceHeader{
+    public:
+    char magic[8] = {'C', 'E', 'T', 'R', 'A', 'C', 'E', '1'};
+    uint32_t record_size = sizeof(TraceRecord);
+    uint32_t sample = 0;
+    uint64_t count = 0;
+
+    // records overwritten because the ring was full
+    uint64_t dropped = 0;
+};
+
+class SearchTracer{
+    public:
+    std::string file_name;
+
+    // one node in sample starts a traced subtree
+    int sample = 1000;
+
+    std::vector<TraceRecord> ring;
+    uint64_t written = 0;
+
+    // traced subtrees so far and visits since the last one started
+    uint32_t subtree_count = 0;
+    int visits = 0;
+
+    SearchTracer(std::string file_name, int sample){
+        this->file_name = file_name;
+        this->sample = std::max(sample, 1);
+        ring.resize(TRACE_RING_RECORDS);
+    }
+
+    void reset(){
+        written = 0;
+        subtree_count = 0;
+        visits = 0;
+    }
+
+    inline void record(const TraceRecord &entry){
+        ring[written++ % TRACE_RING_RECORDS] = entry;
+    }
+
+    // writes the records of the last search, returns false if the file could not be written
+    bool dump(){
+        FILE *file = fopen(file_name.c_str(), "wb");
+
+        if(file == NULL){
+            return false;
+        }
+
+        TraceHeader header;
+        header.sample = sample;
+        header.count = std::min(written, (uint64_t)TRACE_RING_RECORDS);
+        header.dropped = written - header.count;
+
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+        // oldest first, the ring only wraps once it is full
+        uint64_t first = written - header.count;
+
+        for(uint64_t ind = first; ind < written && ok; ind++){
+            ok = fwrite(&ring[ind % TRACE_RING_RECORDS], sizeof(TraceRecord), 1, file) == 1;
+        }
+
+        return fclose(file) == 0 && ok;
+    }
+};
+
+// Traces one node of negamax or quiescence, constructed on entry and recorded when it goes out of scope.
+// Without a tracer only the reason and score stores of exit are left.
+class NodeTrace{
+    public:
+    Searcher *search;
+    bool active = false;
+
+    // whether this node started the sampled subtree
+    bool owner = false;
+
+    TraceRecord entry;
+
+    NodeTrace(Searcher *search, Bitboard key, int alpha, int beta, int depth, int flags){
+        this->search = search;
+
+        entry.reason = trace_none;
+        entry.score = 0;
+
+        if(search->tracer){
+            begin(key, alpha, beta, depth, flags);
+        }
+    }
+
+    ~NodeTrace(){
+        if(active){
+            finish();
+        }
+    }
+
+    // sets how the node returned and passes its score through
+    inline int exit(int reason, int score){
+        entry.reason = reason;
+        entry.score = score;
+
+        return score;
+    }
+
+    inline void ttHit(){
+        entry.flags |= TRACE_TT_HIT;
+    }
+
+    void begin(Bitboard key, int alpha, int beta, int depth, int flags){
+        SearchTracer *tracer = search->tracer;
+
+        if(search->trace_subtree == 0){
+            if(++tracer->visits < tracer->sample){
+                return;
+            }
+
+            tracer->visits = 0;
+            search->trace_subtree = ++tracer->subtree_count;
+            owner = true;
+        }
+
+        Move move = search->ply ? search->played_moves[search->ply]:Move();
+
+        active = true;
+        entry.key = key;
+        entry.alpha = alpha;
+        entry.beta = beta;
+        entry.subtree = search->trace_subtree;
+        entry.move = (move.from == no_sq) ? 0:(move.from | move.to << 6 | move.promotedPiece << 12);
+        entry.ply = search->ply;
+        entry.level = search->trace_level++;
+        entry.depth = depth;
+        entry.flags = flags;
+    }
+
+    void finish(){
+        search->trace_level--;
+        search->tracer->record(entry);
+
+        if(owner){
+            search->trace_subtree = 0;
+        }
+    }
+};
+
+/*----------------------------------*/
+/*      TRANSPOSITION TABLES        */
+/*----------------------------------*/
+
+// hash table size in MB, set with the UCI "Hash" option
+#define DEFAULT_HASH_MB 64
+#define MAX_HASH_MB 65536
+
+// alignment of the table so it starts on a huge page boundary
+#define HASH_ALIGNMENT (2ULL << 20)
+
+#define NOT_FOUND 100000
+
+// hash flags for transposition table implementation
+#define hashFlagExact 0 // PV node (score > alpha)
+#define hashFlagAlpha 1 // fail low(score <= alpha)
+#define hashFlagBeta 2  // fail high(score >= beta)
+
+class transpositionTable{
+    public:
+    Bitboard hashKey = 0ULL;
+    int depth = 0;
+    int hashFlag = 0;   // flag the type of node
+    int score = 0;
+    Move bestMove;      // best move found at this node (empty on fail-low)
+    int generation = 0; // search that wrote the entry, older entries are replaced first
+
+    transpositionTable(){
+        hashKey = 0ULL;
+        depth = 0;
+        hashFlag = 0;
+        score = 0;
+        bestMove = Move();
+        generation = 0;
+    }
+};
+
+// A transposition table, each engine instance owns one
+class HashTable{
+    public:
+    // table allocated at runtime by allocateHashTable
+    transpositionTable *hashTable = NULL;
+    // number of entries in the table
+    Bitboard hash_entries = 0;
+    // size of the allocation in bytes
+    size_t hash_bytes = 0;
+    // whether the table came from mmap (explicit huge pages) rather than the heap
+    bool hash_mmapped = false;
+
+    // current search generation, advanced at the start of every search
+    int hash_generation = 0;
+
+    HashTable(){}
+
+    HashTable(const HashTable &) = delete;
+    HashTable &operator=(const HashTable &) = delete;
+
+    ~HashTable(){
+        freeHashTable();
+    }
+
+    // maps a key to its table index, multiply-shift spreads keys over any table size without a division
+    inline Bitboard hashIndex(Bitboard hashKey) const{
+        return (Bitboard)(((unsigned __int128)hashKey * hash_entries) >> 64);
+    }
+
+    void clearHashRange(Bitboard start, Bitboard end);
+    void clearHashTable();
+    void freeHashTable();
+    void allocateHashTable(int megabytes);
+    bool saveHashTable(std::string fileName);
+    bool loadHashTable(std::string fileName);
+
+    int hashfull();
+    transpositionTable *probeHashEntry(Bitboard hashKey);
+    int readHashEntry(int alpha, int beta, int depth, int ply, Bitboard hashKey);
+    void storeHashEntry(int score, int depth, int hashFlag, Move bestMove, int ply, Bitboard hashKey);
+    void storeQuiescenceHashEntry(int score, int hashFlag, Move bestMove, int ply, Bitboard hashKey);
+};
+
+// clears the table slice [start, end)
+void HashTable::clearHashRange(Bitboard start, Bitboard end){
+    for(Bitboard index = start; index < end; index++){
+        hashTable[index] = transpositionTable();
+    }
+}
+
+// tables below this size are cleared on the calling thread, starting threads would cost more than the clear
+#define HASH_PARALLEL_CLEAR_BYTES (64ULL << 20)
+
+// clears the table split across all hardware threads, also the parallel first touch of a new table
+void HashTable::clearHashTable(){
+    Bitboard threadCount = (hash_bytes < HASH_PARALLEL_CLEAR_BYTES) ? 1:std::max(1, (int)std::thread::hardware_concurrency());
+    Bitboard chunk = (hash_entries + threadCount - 1) / threadCount;
+
+    std::vector<std::thread> threads;
+
+    for(Bitboard start = 0; start < hash_entries; start += chunk){
+        threads.emplace_back(&HashTable::clearHashRange, this, start, std::min(start + chunk, hash_entries));
+    }
+
+    for(std::thread &thread : threads){
+        thread.join();
+    }
+
+    hash_generation = 0;
+}
+
+void HashTable::freeHashTable(){
+    if(hashTable == NULL){
+        return;
+    }
+
+#ifdef __linux__
+    if(hash_mmapped){
+        munmap(hashTable, hash_bytes);
+    }else{
+        free(hashTable);
+    }
+#elif defined(_WIN32)
+    _aligned_free(hashTable);
+#else
+    free(hashTable);
+#endif
+
+    hashTable = NULL;
+    hash_entries = 0;
+    hash_bytes = 0;
+    hash_mmapped = false;
+}
+
+// allocates a table of the given size aligned to 2 MB, backed by huge pages where the OS allows it,
+// throws std::bad_alloc and keeps the current table if the new one cannot be allocated
+void HashTable::allocateHashTable(int megabytes){
+    megabytes = std::max(1, std::min(megabytes, MAX_HASH_MB));
+
+    // round up to whole huge pages
+    size_t bytes = (((size_t)megabytes << 20) + HASH_ALIGNMENT - 1) & ~(size_t)(HASH_ALIGNMENT - 1);
+    bool mmapped = false;
+
+#ifdef __linux__
+    // explicit huge pages from hugetlbfs, only available if the administrator reserved them
+    void *memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+    if(memory != MAP_FAILED){
+        mmapped = true;
+    }else{
+        // fall back to transparent huge pages
+        memory = aligned_alloc(HASH_ALIGNMENT, bytes);
+
+        if(memory){
+            madvise(memory, bytes, MADV_HUGEPAGE);
+        }
+    }
+#elif defined(_WIN32)
+    void *memory = _aligned_malloc(bytes, HASH_ALIGNMENT);
+#else
+    void *memory = aligned_alloc(HASH_ALIGNMENT, bytes);
+#endif
+
+    if(memory == NULL){
+        throw std::bad_alloc();
+    }
+
+    freeHashTable();
+
+    hashTable = (transpositionTable *)memory;
+    hash_bytes = bytes;
+    hash_mmapped = mmapped;
+    hash_entries = hash_bytes / sizeof(transpositionTable);
+
+    clearHashTable();
+}
+
+// hash files start with this header, padded to a page so the entries can be memory-mapped directly
+#define HASH_FILE_HEADER_SIZE 4096
+#define HASH_FILE_VERSION 1
+
+class hashFileHeader{
+    public:
+    char magic[8] = {'B', 'B', 'C', 'H', 'A', 'S', 'H', 0};
+    int version = HASH_FILE_VERSION;
+    int entrySize = sizeof(transpositionTable);
+    Bitboard entries = 0;
+    // keys are only meaningful with the same random seed, side_key catches any other change to key generation
+    unsigned int zobristSeed = RANDOM_SEED;
+    Bitboard sideKey = 0;
+    int generation = 0;
+};
+
+// writes the transposition table to a file, returns false on failure
+bool HashTable::saveHashTable(std::string fileName){
+    FILE *file = fopen(fileName.c_str(), "wb");
+
+    if(file == NULL){
+        return false;
+    }
+
+    char header[HASH_FILE_HEADER_SIZE] = {0};
+    hashFileHeader info;
+    info.entries = hash_entries;
+    info.sideKey = side_key;
+    info.generation = hash_generation;
+    memcpy(header, &info, sizeof(info));
+
+    bool written = fwrite(header, 1, HASH_FILE_HEADER_SIZE, file) == HASH_FILE_HEADER_SIZE
+        && fwrite(hashTable, sizeof(transpositionTable), hash_entries, file) == hash_entries;
+
+    return (fclose(file) == 0) && written;
+}
+
+// replaces the transposition table with one saved by saveHashTable, returns false and keeps the current table on failure
+bool HashTable::loadHashTable(std::string fileName){
+    FILE *file = fopen(fileName.c_str(), "rb");
+
+    if(file == NULL){
+        return false;
+    }
+
+    hashFileHeader info;
+
+    bool valid = fread(&info, sizeof(info), 1, file) == 1 && memcmp(info.magic, hashFileHeader().magic, sizeof(info.magic)) == 0
+        && info.version == HASH_FILE_VERSION && info.entrySize == (int)sizeof(transpositionTable)
+        && info.zobristSeed == RANDOM_SEED && info.sideKey == side_key && info.entries > 0;
+
+    fseek(file, 0, SEEK_END);
+    valid = valid && (Bitboard)ftell(file) >= HASH_FILE_HEADER_SIZE + info.entries * sizeof(transpositionTable);
+
+    if(!valid){
+        fclose(file);
+        return false;
+    }
+
+    size_t bytes = info.entries * sizeof(transpositionTable);
+
+#ifdef __linux__
+    fclose(file);
+
+    // private mapping, entries are paged in on first access and later writes never reach the file
+    int fd = open(fileName.c_str(), O_RDONLY);
+    void *memory = (fd < 0) ? MAP_FAILED:mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, HASH_FILE_HEADER_SIZE);
+
+    if(fd >= 0){
+        close(fd);
+    }
+
+    if(memory == MAP_FAILED){
+        return false;
+    }
+
+    freeHashTable();
+
+    hashTable = (transpositionTable *)memory;
+    hash_bytes = bytes;
+    hash_mmapped = true;
+#else
+    allocateHashTable((int)((bytes + (1 << 20) - 1) >> 20));
+
+    fseek(file, HASH_FILE_HEADER_SIZE, SEEK_SET);
+    Bitboard count = std::min(info.entries, hash_entries);
+    bool read = fread(hashTable, sizeof(transpositionTable), count, file) == count;
+    fclose(file);
+
+    if(!read){
+        clearHashTable();
+        return false;
+    }
+
+    info.entries = count;
+#endif
+
+    hash_entries = info.entries;
+    hash_generation = info.generation;
+
+    return true;
+}
+
+static inline void prefetchHashEntry(const HashTable *table, Bitboard hashKey){
+    __builtin_prefetch(&table->hashTable[table->hashIndex(hashKey)]);
+}
+
+// returns the table entry for the given position, or NULL if the slot holds another position
+inline transpositionTable *HashTable::probeHashEntry(Bitboard hashKey){
+    transpositionTable *hashEntry = &hashTable[hashIndex(hashKey)];
+
+    return (hashEntry->hashKey == hashKey) ? hashEntry:NULL;
+}
+
+// ply is the distance from the root, mate scores are stored relative to the node
+inline int HashTable::readHashEntry(int alpha, int beta, int depth, int ply, Bitboard hashKey){
+    transpositionTable *hashEntry = &hashTable[hashIndex(hashKey)];
+
+    // if table entry matches current position
+    if(hashEntry->hashKey == hashKey){
+        if(hashEntry->depth >= depth){
+            int score = hashEntry->score;
+
+            if(score < -mate_score){
+                score += ply;
+            }
+
+            if(score > mate_score){
+                score -= ply;
+            }
+
+            // match PV node score
+            if(hashEntry->hashFlag == hashFlagExact){
+                return score;
+            }
+
+            // match fail-low score
+            if((hashEntry->hashFlag == hashFlagAlpha) && (score <= alpha)){
+                return alpha;
+            }
+
+            // match fail-high score
+            if((hashEntry->hashFlag == hashFlagBeta) && (score >= beta)){
+                return beta;
+            }
+        }
+    }
+
+    return NOT_FOUND;
+}
+
+// permill of the entries written during the current search, estimated from the first thousand entries
+int HashTable::hashfull(){
+    Bitboard sample = std::min(hash_entries, (Bitboard)1000);
+    Bitboard used = 0;
+
+    for(Bitboard ind = 0; ind < sample; ind++){
+        if(hashTable[ind].hashKey && hashTable[ind].generation == hash_generation){
+            used++;
+        }
+    }
+
+    return sample ? used * 1000 / sample:0;
+}
+
+inline void HashTable::storeHashEntry(int score, int depth, int hashFlag, Move bestMove, int ply, Bitboard hashKey){
+    transpositionTable *hashEntry = &hashTable[hashIndex(hashKey)];
+
+    // keep deeper results of another position written during this search
+    if(hashEntry->hashKey != hashKey && hashEntry->generation == hash_generation && hashEntry->depth > depth){
+        return;
+    }
+
+    if(score < -mate_score){
+        score -= ply;
+    }
+
+    if(score > mate_score){
+        score += ply;
+    }
+
+    // a fail-low or stand-pat result has no move of its own, the move found earlier for this position still orders it best
+    if(bestMove.from != no_sq || hashEntry->hashKey != hashKey){
+        hashEntry->bestMove = bestMove;
+    }
+
+    hashEntry->hashKey = hashKey;
+    hashEntry->depth = depth;
+    hashEntry->hashFlag = hashFlag;
+    hashEntry->score = score;
+    hashEntry->generation = hash_generation;
+}
+
+// stores a quiescence result at depth 0 without evicting entries written by the main search during this search
+inline void HashTable::storeQuiescenceHashEntry(int score, int hashFlag, Move bestMove, int ply, Bitboard hashKey){
+    transpositionTable *hashEntry = &hashTable[hashIndex(hashKey)];
+
+    if(hashEntry->depth > 0 && hashEntry->generation == hash_generation){
+        return;
+    }
+
+    storeHashEntry(score, 0, hashFlag, bestMove, ply, hashKey);
+}
+
+/*----------------------------------*/
+/*        MOVE SCORE/ORDERING       */
+/*----------------------------------*/
+
+// enable PV move scoring
+inline void Searcher::enablePVScoring(MoveList move_list){
+    // clear follow pv flag
+    follow_pv = 0;
+
+    // loop over the moves within move list
+    for(int count = 0; count < move_list.count; count++){
+        // match with current pv move
+        if(pv_table[0][ply] == move_list.moves[count]){
+            // set pv flags
+            score_pv = 1;
+            follow_pv = 1;
+        }
+    }
+}
+
+// Scores a move based off of mvv lva lookup table
+inline int Searcher::scoreMove(Move move, BoardContainer boards, Move hashMove){
+    // pv move scoring
+    if(score_pv){
+        // check if move matches pv move
+        if(pv_table[0][ply] == move){
+            // clear score pv flag
+            score_pv = 0;
+
+            return 20000;
+        }
+    }
+
+    // transposition table move scoring
+    if(hashMove == move){
+        return 15000;
+    }
+
+    if(move.flags & CAPTURE){ // Score captures
+        int target = P;
+
+        int startInd, endInd;
+        if(boards.board.side == White){
+            startInd = p;
+            endInd = k;
+        }else{
+            startInd = P;
+            endInd = K;
+        }
+
+        for(int piece = startInd; piece <= endInd; piece++){
+            if(getSquare(boards.board.pieceBoards[piece], move.to)){
+                target = piece;
+                break;
+            }
+        }
+        
+        return mvv_lva[move.piece][target] + 10000;
+    }else{ // Score quiet moves
+        if(killer_moves[0][ply] == move){
+            return 9000;
+        }else if(killer_moves[1][ply] == move){
+            return 8000;
+        }
+
+        Move prev = played_moves[ply];
+
+        if(prev.from != no_sq && counter_moves[prev.piece][prev.to] == move){
+            return 7000;
+        }
+
+        // history scores stay below the countermove score since each table is bounded by history_max
+        int score = history_moves[move.piece][move.to];
+
+        if(prev.from != no_sq){
+            score += continuation_history[prev.piece][prev.to][move.piece][move.to];
+        }
+
+        if(ply >= 2 && played_moves[ply - 1].from != no_sq){
+            score += continuation_history[played_moves[ply - 1].piece][played_moves[ply - 1].to][move.piece][move.to];
+        }
+
+        return score;
+    }
+    return 0;
+}
+
+// history gravity, large values move less so the entry converges within [-history_max, history_max]
+static inline void updateHistory(int &entry, int bonus){
+    entry += bonus - entry * abs(bonus) / history_max;
+}
+
+// rewards the quiet move that caused a beta cutoff and penalizes the quiet moves searched before it
+inline void Searcher::updateQuietHeuristics(Move move, int depth, Move *quiets, int quiet_count){
+    int bonus = std::min(16 * depth * depth, 1200);
+
+    // store killer moves
+    if(!(killer_moves[0][ply] == move)){
+        killer_moves[1][ply] = killer_moves[0][ply];
+        killer_moves[0][ply] = move;
+    }
+
+    Move prev = played_moves[ply];
+    Move prev2 = (ply >= 2) ? played_moves[ply - 1]:Move();
+
+    if(prev.from != no_sq){
+        counter_moves[prev.piece][prev.to] = move;
+    }
+
+    for(int ind = 0; ind < quiet_count; ind++){
+        Move quiet = quiets[ind];
+        int quiet_bonus = (quiet == move) ? bonus:-bonus;
+
+        updateHistory(history_moves[quiet.piece][quiet.to], quiet_bonus);
+
+        if(prev.from != no_sq){
+            updateHistory(continuation_history[prev.piece][prev.to][quiet.piece][quiet.to], quiet_bonus);
+        }
+
+        if(prev2.from != no_sq){
+            updateHistory(continuation_history[prev2.piece][prev2.to][quiet.piece][quiet.to], quiet_bonus);
+        }
+    }
+}
+
+// scales the history tables down between searches so old statistics fade instead of being thrown away
+void Searcher::ageHistory(){
+    for(int piece = 0; piece < 12; piece++){
+        for(int square = 0; square < 64; square++){
+            history_moves[piece][square] /= 2;
+        }
+    }
+
+    int *entry = &continuation_history[0][0][0][0];
+
+    for(int ind = 0; ind < 12*64*12*64; ind++){
+        entry[ind] /= 2;
+    }
+}
+
+// forgets all move ordering statistics, for a new game
+void Searcher::clearHistory(){
+    memset(history_moves, 0, sizeof(history_moves));
+    memset(continuation_history, 0, sizeof(continuation_history));
+
+    for(int piece = 0; piece < 12; piece++){
+        for(int square = 0; square < 64; square++){
+            counter_moves[piece][square] = Move();
+        }
+    }
+}
+
+// prints all move scores
+void Searcher::printMoveScores(MoveList move_list, BoardContainer boards){
+    std::cout << "Move Scores\n\n";
+    for(int ind = 0; ind < move_list.count; ind++){
+        std::cout << "Move: ";
+        move_list.moves[ind].print();
+        std::cout << " Score: " << scoreMove(move_list.moves[ind], boards) << std::endl;
+    }
+}
+
+// sort moves in descending order
+inline int Searcher::sortMoves(MoveList &move_list, BoardContainer boards, Move hashMove){
+    int moveScores[move_list.count];
+    
+    for (int ind = 0; ind < move_list.count; ind++){
+        moveScores[ind] = scoreMove(move_list.moves[ind], boards, hashMove);
+    }
+    
+    for (int ind = 0; ind < move_list.count; ind++)    {
+        for (int nextInd = ind + 1; nextInd < move_list.count; nextInd++)
+        {
+            // compare current and next move scores
+            if (moveScores[ind] < moveScores[nextInd])
+            {
+                // swap scores
+                int temp_score = moveScores[ind];
+                moveScores[ind] = moveScores[nextInd];
+                moveScores[nextInd] = temp_score;
+                
+                // swap moves
+                Move temp_move = move_list.moves[ind];
+                move_list.moves[ind] = move_list.moves[nextInd];
+                move_list.moves[nextInd] = temp_move;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*----------------------------------*/
+/*              SEARCH              */
+/*----------------------------------*/
+
+static inline bool is_repeated(BoardContainer boards){
+    for(int count = 0; count < boards.board.rep_ind; count++){
+        if(boards.board.repetition_table[count] == boards.board.hashKey){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// quiescence search
+int Searcher::quiescence(int alpha, int beta, BoardContainer boards){
+    NodeTrace trace(this, boards.board.hashKey, alpha, beta, 0, TRACE_QUIESCENCE);
+
+    // Check gui input every 2047 nodes
+    if((nodes & 2047) == 0){
+        communicate();
+    }
+    
+    nodes++;
+    STAT(quiescence_nodes);
+
+    if(ply > MAX_PLY - 1){
+        return trace.exit(trace_horizon, evaluate(boards));
+    }
+
+    // Checks if current node is a pv node
+    bool isPV = (beta - alpha) > 1;
+
+    int hashScore;
+
+    // quiescence results are stored at depth 0, so any entry for this position can cut
+    if(ply && !isPV && (hashScore = table->readHashEntry(alpha, beta, 0, ply, boards.board.hashKey)) != NOT_FOUND){
+        trace.ttHit();
+        return trace.exit(trace_tt_cutoff, hashScore);
+    }
+
+    // best capture from an earlier visit, searched first
+    Move hashMove;
+
+    transpositionTable *hashEntry = table->probeHashEntry(boards.board.hashKey);
+
+    if(hashEntry){
+        trace.ttHit();
+        hashMove = hashEntry->bestMove;
+    }
+
+    int original_alpha = alpha;
+
+    Move bestMove;
+
+    int eval = evaluate(boards);
+
+    // fail hard beta cutoff, node fails high
+    if(eval >= beta){
+        table->storeQuiescenceHashEntry(beta, hashFlagBeta, bestMove, ply, boards.board.hashKey);
+
+        return trace.exit(trace_stand_pat, beta);
+    }
+
+    // fount a better move
+    if(eval > alpha){
+        // PV node
+        alpha = eval;
+    }
+
+    MoveList move_list;
+
+    boards.board.generateMoves(move_list);
+
+    sortMoves(move_list, boards, hashMove);
+
+    for(int ind = 0; ind < move_list.count; ind++){
+        boards.saveBoard();
+
+        ply++;
+
+        boards.board.repetition_table[boards.board.rep_ind] = boards.board.hashKey;
+        boards.board.rep_ind++;
+
+        if(boards.makeMove(move_list.moves[ind], captures) == 0){
+            ply--;
+
+            boards.board.rep_ind--;
+
+            continue;
+        }
+
+        played_moves[ply] = move_list.moves[ind];
+
+        int score = -quiescence(-beta, -alpha, boards);
+
+        ply--;
+
+        boards.board.rep_ind--;
+
+        boards.restoreBoard();
+
+        // time is up
+        if(stopped){
+            return trace.exit(trace_stopped, 0);
+        }
+
+        // fount a better move
+        if(score > alpha){
+            // PV node
+            alpha = score;
+
+            bestMove = move_list.moves[ind];
+
+            // fail hard beta cutoff, node fails high
+            if(score >= beta){
+                table->storeQuiescenceHashEntry(beta, hashFlagBeta, bestMove, ply, boards.board.hashKey);
+
+                return trace.exit(trace_beta_cutoff, beta);
+            }
+        }
+    }
+
+    table->storeQuiescenceHashEntry(alpha, (alpha > original_alpha) ? hashFlagExact:hashFlagAlpha, bestMove, ply, boards.board.hashKey);
+
+    return trace.exit((alpha > original_alpha) ? trace_exact:trace_fail_low, alpha);
+}
+
+const int full_depth_moves = 4;
+const int reduction_limit = 3;
+
+// minimum depth for singular extension verification search
+const int singular_depth_limit = 6;
+// how much shallower than the current node the hash entry may be for its move to be tested
+const int singular_tt_depth_margin = 3;
+
+// negamax alpha beta search, excludedMove is skipped during singular extension verification
+int Searcher::negamax(int alpha, int beta, int depth, BoardContainer boards, Move excludedMove){    
+    // static evaluation score
+    int score;
+
+    int hashFlag = hashFlagAlpha;
+
+    // singular extension verification search at this node
+    bool excluding = excludedMove.from != no_sq;
+
+    // the root of a MultiPV line after the first is searched without the better lines' moves, its score is not the position's
+    bool partial = excluding || (ply == 0 && multipv_index > 0);
+
+    NodeTrace trace(this, boards.board.hashKey, alpha, beta, depth, excluding ? TRACE_EXCLUDED:0);
+
+    // if repeated position
+    if(ply && is_repeated(boards)){
+        return trace.exit(trace_repetition, 0);
+    }
+
+    // Checks if current node is a pv node
+    bool isPV = (beta - alpha) > 1;
+    
+    if(ply && !excluding){
+        STAT(tt_probes);
+    }
+
+    // check if move has already been searched (is in transposition table)
+    if(ply && !excluding && (score = table->readHashEntry(alpha, beta, depth, ply, boards.board.hashKey)) != NOT_FOUND && !isPV){
+        STAT(tt_cutoffs);
+        STAT(tt_hits);
+        trace.ttHit();
+        return trace.exit(trace_tt_cutoff, score);
+    }
+
+    // hash move and its stored bound for move ordering and singular extensions
+    Move hashMove;
+    int hashScore = 0, hashDepth = -1, hashEntryFlag = hashFlagAlpha;
+
+    transpositionTable *hashEntry = table->probeHashEntry(boards.board.hashKey);
+
+    if(hashEntry){
+        if(ply && !excluding){
+            STAT(tt_hits);
+        }
+
+        trace.ttHit();
+
+        hashMove = hashEntry->bestMove;
+        hashDepth = hashEntry->depth;
+        hashEntryFlag = hashEntry->hashFlag;
+        hashScore = hashEntry->score;
+
+        if(hashScore < -mate_score){
+            hashScore += ply;
+        }
+
+        if(hashScore > mate_score){
+            hashScore -= ply;
+        }
+    }
+
+    // Check gui input every 2047 nodes
+    if((nodes & 2047) == 0){
+        communicate();
+    }
+
+    // init pv length
+    pv_length[ply] = ply;
+
+    // escape condition
+    if(depth == 0){
+        return trace.exit(trace_quiescence, quiescence(alpha, beta, boards));
+    }
+
+    // ply overflow handling
+    if(ply > MAX_PLY - 1){
+        return trace.exit(trace_horizon, evaluate(boards));
+    }
+
+    nodes++;
+    STAT(main_nodes);
+
+    int in_check = boards.board.isAttacked((boards.board.side == White) ? findLSB(boards.board.pieceBoards[K]):findLSB(boards.board.pieceBoards[k]), boards.board.side^1);
+
+    // increase depth if king in check
+    if(in_check){
+        depth++;
+    }
+
+    int legal_moves = 0;
+
+    // null move pruning
+    if(depth >= 3 && in_check == 0 && ply && !excluding){
+        boards.saveBoard();
+
+        ply++;
+
+        boards.board.repetition_table[boards.board.rep_ind] = boards.board.hashKey;
+        boards.board.rep_ind++;
+
+        // Give enemy an extra move
+        boards.board.side ^= 1; 
+        // Update hash key
+        boards.board.hashKey ^= side_key;
+
+        if(boards.board.enpassant != no_sq){
+            boards.board.hashKey ^= enpassant_keys[boards.board.enpassant];
+        }
+
+        boards.board.enpassant = no_sq;
+
+        prefetchHashEntry(table, boards.board.hashKey);
+
+        played_moves[ply] = Move();
+
+        STAT(null_tries);
+
+        // Find beta cutoffs within depth - 1 - R moves
+        score = -negamax(-beta, -beta + 1, depth - 1 - 2, boards);
+
+        ply--;
+
+        boards.board.rep_ind--;
+
+        boards.restoreBoard();
+
+        // time is up
+        if(stopped){
+            return trace.exit(trace_stopped, 0);
+        }
+
+        // beta cutoff
+        if(score >= beta){
+            STAT(null_cutoffs);
+            return trace.exit(trace_null_cutoff, beta);
+        }
+    }
+
+    // singular extension
+    // if every other move fails low against a margin below the hash score, the hash move is the only good move and gets extended
+    // if they fail high instead, several moves beat beta and the node is cut (multi-cut)
+    int singular_extension = 0;
+
+    if(ply && !excluding && depth >= singular_depth_limit && hashMove.from != no_sq && hashEntryFlag != hashFlagAlpha 
+        && hashDepth >= depth - singular_tt_depth_margin && hashScore > -mate_score && hashScore < mate_score){
+        int singular_beta = hashScore - 2*depth;
+
+        score = negamax(singular_beta - 1, singular_beta, (depth - 1) / 2, boards, hashMove);
+
+        // the verification search shares this ply, reset the pv line it may have written
+        pv_length[ply] = ply;
+
+        // time is up
+        if(stopped){
+            return trace.exit(trace_stopped, 0);
+        }
+
+        if(score < singular_beta){
+            singular_extension = 1;
+        }else if(singular_beta >= beta){
+            return trace.exit(trace_multi_cut, singular_beta);
+        }
+    }
+
+    MoveList move_list;
+
+    if(ply){
+        boards.board.generateMoves(move_list);
+    }else{
+        // the root searches its persistent move list, already ordered by the previous iteration,
+        // without the moves of the better MultiPV lines
+        for(int ind = multipv_index; ind < root_move_count; ind++){
+            move_list.addMove(root_moves[ind].move);
+        }
+    }
+
+    if(follow_pv){
+        // enable pv move scoring
+        enablePVScoring(move_list);
+    }
+
+    if(ply){
+        sortMoves(move_list, boards, hashMove);
+    }else{
+        score_pv = 0;
+    }
+
+    // number of moves searched in a move list
+    int moves_searched = 0;
+
+    Move bestMove;
+
+    // quiet moves searched so far, penalized if a later move causes a cutoff
+    Move quiets_searched[64];
+    int quiet_count = 0;
+
+    for(int ind = 0; ind < move_list.count; ind++){
+        if(excluding && move_list.moves[ind] == excludedMove){
+            continue;
+        }
+
+        boards.saveBoard();
+
+        ply++;
+
+        boards.board.repetition_table[boards.board.rep_ind] = boards.board.hashKey;
+        boards.board.rep_ind++;
+
+        if(boards.makeMove(move_list.moves[ind], all) == 0){
+            ply--;
+
+            boards.board.rep_ind--;
+
+            continue;
+        }
+
+        played_moves[ply] = move_list.moves[ind];
+
+        legal_moves++;
+
+        unsigned long long nodes_before = nodes;
+
+        // depth to search the child with, extended if this is a singular hash move
+        int new_depth = depth - 1 + ((singular_extension && move_list.moves[ind] == hashMove) ? singular_extension:0);
+
+        // normal alpha beta algo
+        if(moves_searched == 0){ // full depth search
+            score = -negamax(-beta, -alpha, new_depth, boards);
+        }else{ // Late move reduction
+            // Checks if lmr is possible
+            if((moves_searched >= full_depth_moves) && (depth >= reduction_limit) && (in_check == 0) && ((move_list.moves[ind].flags & CAPTURE) == 0) && (move_list.moves[ind].promotedPiece == P)){
+                STAT(lmr_tries);
+                score = -negamax(-alpha - 1, -alpha, new_depth - 1, boards);
+
+                if(score > alpha){
+                    STAT(lmr_researches);
+                }
+            }else{
+                score = alpha + 1;
+            }
+
+            // principal variation search
+            if(score > alpha){
+                STAT(pvs_tries);
+                score = -negamax(-alpha - 1, -alpha, new_depth, boards);
+
+                if((score > alpha) && (score < beta)){
+                    STAT(pvs_researches);
+                    score = -negamax(-beta, -alpha, new_depth, boards);
+                }
+            }
+        }
+
+        ply--;
+
+        boards.board.rep_ind--;
+
+        boards.restoreBoard();
 
         // time is up
         if(stopped){
-            return 0;
+            return trace.exit(trace_stopped, 0);
+        }
+
+        if(ply == 0){
+            root_moves[multipv_index + ind].nodes += nodes - nodes_before;
+
+            if(score > alpha){
+                root_moves[multipv_index + ind].score = score;
+            }
+        }
+
+        moves_searched++;
+
+        if((move_list.moves[ind].flags & CAPTURE) == 0 && quiet_count < 64){
+            quiets_searched[quiet_count++] = move_list.moves[ind];
+        }
+
+        // found a better move
+        if(score > alpha){
+            hashFlag = hashFlagExact;
+
+            // PV node
+            alpha = score;
+
+            bestMove = move_list.moves[ind];
+
+            // PV move
+            pv_table[ply][ply] = move_list.moves[ind];
+
+            for(int next_ply = ply + 1; next_ply < pv_length[ply + 1]; next_ply++){
+                // copy move from deeper ply into current ply's line
+                pv_table[ply][next_ply] = pv_table[ply + 1][next_ply];
+            }
+
+            pv_length[ply] = pv_length[ply + 1];
+
+            // fail hard beta cutoff, node fails high
+            if(score >= beta){
+                STAT(fail_highs);
+
+                if(moves_searched == 1){
+                    STAT(first_move_fail_highs);
+                }
+
+                if(!partial){
+                    table->storeHashEntry(beta, depth, hashFlagBeta, bestMove, ply, boards.board.hashKey);
+                }
+
+                if((move_list.moves[ind].flags & CAPTURE) == 0){
+                    // store killer, countermove and history heuristics
+                    updateQuietHeuristics(move_list.moves[ind], depth, quiets_searched, quiet_count);
+                }
+
+                return trace.exit(trace_beta_cutoff, beta);
+            }
+        }
+    }
+
+    if(legal_moves == 0){
+        // only the excluded move is legal, so it is trivially singular
+        if(excluding){
+            return trace.exit(trace_fail_low, alpha);
+        }
+
+        if(in_check){
+            return trace.exit(trace_mate, -mate_value + ply);
+        }else{
+            return trace.exit(trace_stalemate, 0);
+        }
+    }
+
+    if(!partial){
+        table->storeHashEntry(alpha, depth, hashFlag, bestMove, ply, boards.board.hashKey);
+    }
+
+    // node fails low
+    return trace.exit((hashFlag == hashFlagExact) ? trace_exact:trace_fail_low, alpha);
+}
+
+// aspiration windows are only used once the score has settled over a few iterations
+const int aspiration_depth_limit = 4;
+// smallest half-width of the aspiration window
+const int aspiration_min_window = 20;
+
+// easy move: stop early once the best move has been stable for this many iterations...
+const int easy_move_stable_iterations = 4;
+// ...used at least this percentage of the iteration's nodes...
+const int easy_move_node_percent = 90;
+// ...and at least this fraction of the allotted time has passed
+const int easy_move_time_divisor = 5;
+
+// fills root_moves with the legal moves of the position, restricted to search_moves if given
+void Searcher::initRootMoves(BoardContainer boards){
+    MoveList move_list;
+
+    boards.board.generateMoves(move_list);
+
+    // initial order comes from the regular move ordering
+    sortMoves(move_list, boards);
+
+    root_move_count = 0;
+
+    for(int pass = 0; pass < 2 && root_move_count == 0; pass++){
+        for(int ind = 0; ind < move_list.count; ind++){
+            Move move = move_list.moves[ind];
+
+            // first pass honours searchmoves, fall back to every move if none of them are legal
+            if(pass == 0 && !search_moves.empty() && std::find(search_moves.begin(), search_moves.end(), move.toString()) == search_moves.end()){
+                continue;
+            }
+
+            boards.saveBoard();
+
+            if(boards.makeMove(move, all)){
+                root_moves[root_move_count++] = RootMove(move);
+                boards.restoreBoard();
+            }
+        }
+    }
+}
+
+// orders the root moves from first on for the next iteration, moves that raised alpha by score, the rest by subtree size,
+// with best, the move of the line just found, in front
+void Searcher::sortRootMoves(int first, Move best){
+    std::stable_sort(root_moves + first, root_moves + root_move_count, [](const RootMove &a, const RootMove &b){
+        if(a.score != b.score){
+            return a.score > b.score;
+        }
+
+        return a.nodes > b.nodes;
+    });
+
+    for(int ind = first + 1; ind < root_move_count; ind++){
+        if(root_moves[ind].move == best){
+            std::rotate(root_moves + first, root_moves + ind, root_moves + ind + 1);
+            break;
+        }
+    }
+}
+
+// the line just searched, its pv is in pv_table[0]
+SearchInfo Searcher::lineInfo(int depth, int score){
+    SearchInfo info;
+
+    info.multipv = multipv_index + 1;
+    info.depth = depth;
+    info.score = score;
+    info.nodes = nodes;
+    info.time = get_time_ms() - starttime;
+    info.hashfull = table->hashfull();
+
+    if (score > -mate_value && score < -mate_score){
+        info.mate = -(score + mate_value) / 2 - 1;
+    }else if (score > mate_score && score < mate_value){
+        info.mate = (mate_value - score) / 2 + 1;
+    }else{
+        info.mate = 0;
+    }
+
+    for(int count = 0; count < pv_length[0]; count++){
+        info.pv.push_back(pv_table[0][count].toString());
+    }
+
+    return info;
+}
+
+// runs iterative deepening on the position within the limits set by setLimits, the caller clears stopped
+SearchResult Searcher::searchPosition(int depth, BoardContainer boards){
+    // "go mate" is answered by the proof-number solver
+    if(mate_moves){
+        return solveMate(boards);
+    }
+
+    int score = 0;
+
+    // last completed iteration
+    SearchResult result;
+
+    boards.table = table;
+
+    if(scheduler){
+        waitForCore();
+    }
+
+    // running average of how much the score moved between iterations, used to size the aspiration window
+    int score_volatility = 30;
+
+    // reset nodes, and follow PV flags
+    nodes = 0;
+    follow_pv = 0;
+    score_pv = 0;
+    // stopped is cleared by whoever starts the search, before the search thread exists, so an early "stop" is never lost
+
+    // entries from earlier searches become replaceable but stay usable
+    table->hash_generation++;
+
+    // clear pv and killers, history is only aged so it carries over between moves
+    memset(killer_moves, 0, sizeof(killer_moves));
+    ageHistory();
+    memset(pv_table, 0, sizeof(pv_table));
+    memset(pv_length, 0, sizeof(pv_length));
+    memset(multipv_pv, 0, sizeof(multipv_pv));
+    memset(multipv_scores, 0, sizeof(multipv_scores));
+
+    stats = SearchStats();
+
+    trace_subtree = 0;
+    trace_level = 0;
+
+    if(tracer){
+        tracer->reset();
+    }
+
+    initRootMoves(boards);
+
+    // number of consecutive iterations that ended with the same best move
+    int stable_iterations = 0;
+    Move last_best_move;
+
+    // duration and size of the previous iteration to predict the next one
+    unsigned long long last_iteration_nodes = 0;
+    
+    // iterative deepening
+    for(int current_depth = 1; current_depth <= depth; current_depth++){        
+        // if time is up
+        if(stopped){
+            break;
+        }
+
+        int prev_score = score;
+
+        int iteration_start = get_time_ms();
+        unsigned long long iteration_start_nodes = nodes;
+
+        for(int ind = 0; ind < root_move_count; ind++){
+            root_moves[ind].nodes = 0;
+        }
+
+        // lines of this iteration, best first
+        std::vector<SearchInfo> lines;
+        int line_count = std::max(1, std::min(multipv, root_move_count));
+
+        // MultiPV, every line searches the root without the moves of the lines found before it
+        for(multipv_index = 0; multipv_index < line_count; multipv_index++){
+            // each line's window is centred on its score in the previous iteration
+            int line_score = multipv_index ? multipv_scores[multipv_index]:score;
+
+            int window = aspiration_min_window + score_volatility;
+            int alpha = -infinity;
+            int beta = infinity;
+
+            if(current_depth >= aspiration_depth_limit && line_score > -mate_score && line_score < mate_score){
+                alpha = std::max(line_score - window, -infinity);
+                beta = std::min(line_score + window, infinity);
+            }
+
+            // follow the line's pv from the previous iteration
+            memcpy(pv_table[0], multipv_pv[multipv_index], sizeof(pv_table[0]));
+
+            // re-search the current depth, widening only the bound that failed
+            while(true){
+                // scores from a failed window are bounds of that window, not comparable with the re-search's
+                for(int ind = multipv_index; ind < root_move_count; ind++){
+                    root_moves[ind].score = -infinity;
+                }
+
+                // set follow_pv flag
+                follow_pv = 1;
+
+                int result = negamax(alpha, beta, current_depth, boards);
+
+                if(stopped){
+                    break;
+                }
+
+                if(result <= alpha){
+                    alpha = std::max(result - window, -infinity);
+                }else if(result >= beta){
+                    beta = std::min(result + window, infinity);
+                }else{
+                    line_score = result;
+                    break;
+                }
+
+                window *= 2;
+            }
+
+            if(stopped){
+                break;
+            }
+
+            multipv_scores[multipv_index] = line_score;
+            memcpy(multipv_pv[multipv_index], pv_table[0], sizeof(pv_table[0]));
+
+            if(multipv_index == 0){
+                score = line_score;
+            }
+
+            sortRootMoves(multipv_index, pv_table[0][0]);
+
+            lines.push_back(lineInfo(current_depth, line_score));
+        }
+
+        multipv_index = 0;
+
+        // the interrupted iteration has no reliable score
+        if(stopped){
+            break;
+        }
+
+        if(current_depth > 1){
+            score_volatility = (score_volatility + abs(score - prev_score)) / 2;
+        }
+
+        stats.depth_nodes[current_depth] = nodes - iteration_start_nodes;
+        stats.last_depth = current_depth;
+
+        if(info_callback){
+            for(const SearchInfo &line : lines){
+                info_callback(line);
+            }
+        }
+
+        static_cast<SearchInfo &>(result) = lines[0];
+        result.lines = lines;
+
+        if(timeset && !pondering && root_move_count > 0){
+            if(root_moves[0].move == last_best_move){
+                stable_iterations++;
+            }else{
+                stable_iterations = 0;
+                last_best_move = root_moves[0].move;
+            }
+
+            unsigned long long iteration_nodes = 0;
+
+            for(int ind = 0; ind < root_move_count; ind++){
+                iteration_nodes += root_moves[ind].nodes;
+            }
+
+            // observed growth of the tree from one iteration to the next
+            unsigned long long total_iteration_nodes = nodes - iteration_start_nodes;
+            double branching_factor = last_iteration_nodes ? (double)total_iteration_nodes / last_iteration_nodes:3.0;
+            branching_factor = std::max(1.5, std::min(branching_factor, 10.0));
+            last_iteration_nodes = total_iteration_nodes;
+
+            // a forced move needs no further search
+            if(root_move_count == 1){
+                break;
+            }
+
+            // easy move, the best move is stable and the alternatives are refuted quickly
+            if(stable_iterations >= easy_move_stable_iterations && root_moves[0].nodes * 100 >= iteration_nodes * easy_move_node_percent
+                && get_time_ms() - starttime >= (soft_stoptime - starttime) / easy_move_time_divisor){
+                break;
+            }
+
+            if(!timeForNextIteration(get_time_ms() - iteration_start, branching_factor, stable_iterations, prev_score - score)){
+                break;
+            }
+        }
+    }
+
+    releaseCore();
+
+    // a ponder search may not report before "ponderhit" or "stop"
+    while(pondering && !stopped){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // the pv of the last completed iteration, the reply expected to our best move is its second move
+    if(!result.pv.empty()){
+        result.bestMove = result.pv[0];
+    }else if(root_move_count > 0){
+        // stopped before the first iteration completed
+        result.bestMove = root_moves[0].move.toString();
+    }
+
+    if(result.pv.size() > 1){
+        result.ponderMove = result.pv[1];
+    }
+
+    result.nodes = nodes;
+
+    return result;
+}
+
+/*----------------------------------*/
+/*            MATE SEARCH           */
+/*----------------------------------*/
+
+// Depth-first proof-number search (df-pn) for a forced mate of the side to move within a number of plies.
+// The mating side needs one move that mates, the defender has to run out of all of its moves, so the search
+// follows the position that is cheapest to prove or refute instead of searching every move to full depth.
+
+// adds proof numbers, sums that reach proof_infinity stay there
+static inline int proofSum(int a, int b){
+    return std::min(a + b, proof_infinity);
+}
+
+// proof and disproof numbers of a position with plies left, a mate in fewer plies or a refutation with more also holds
+void Searcher::probeProof(Bitboard key, int plies, int &proof, int &disproof){
+    ProofEntry &entry = proof_table[key & (PROOF_TABLE_ENTRIES - 1)];
+
+    proof = 1;
+    disproof = 1;
+
+    if(entry.key != key){
+        return;
+    }
+
+    if(entry.plies == plies){
+        proof = entry.proof;
+        disproof = entry.disproof;
+    }else if(entry.proof == 0 && entry.plies < plies){
+        proof = 0;
+        disproof = proof_infinity;
+    }else if(entry.disproof == 0 && entry.plies > plies){
+        proof = proof_infinity;
+        disproof = 0;
+    }
+}
+
+void Searcher::storeProof(Bitboard key, int plies, int proof, int disproof){
+    ProofEntry &entry = proof_table[key & (PROOF_TABLE_ENTRIES - 1)];
+
+    entry.key = key;
+    entry.plies = plies;
+    entry.proof = proof;
+    entry.disproof = disproof;
+}
+
+// expands the position until its proof number reaches proof_threshold or its disproof number disproof_threshold
+void Searcher::proofSearch(BoardContainer boards, int plies, int proof_threshold, int disproof_threshold){
+    nodes++;
+
+    // Check gui input every 2047 nodes
+    if((nodes & 2047) == 0){
+        communicate();
+    }
+
+    bool attacker = boards.board.side == mate_side;
+    Bitboard key = boards.board.hashKey;
+
+    MoveList move_list;
+    boards.board.generateMoves(move_list);
+
+    // legal moves and the keys of the positions they lead to
+    Move moves[256];
+    Bitboard keys[256];
+    int count = 0;
+
+    for(int ind = 0; ind < move_list.count; ind++){
+        boards.saveBoard();
+
+        if(boards.makeMove(move_list.moves[ind], all) == 0){
+            continue;
+        }
+
+        moves[count] = move_list.moves[ind];
+        keys[count++] = boards.board.hashKey;
+
+        boards.restoreBoard();
+
+        // the defender only has to show it is not mated
+        if(plies == 0){
+            break;
+        }
+    }
+
+    // mated, stalemated or out of plies, only a mated defender proves the mate
+    if(count == 0 || plies == 0){
+        bool mated = count == 0 && boards.board.isAttacked(findLSB(boards.board.pieceBoards[boards.board.side == White ? K:k]), getEnemy(boards.board.side));
+
+        if(!attacker && mated){
+            storeProof(key, plies, 0, proof_infinity);
+        }else{
+            storeProof(key, plies, proof_infinity, 0);
+        }
+
+        return;
+    }
+
+    while(true){
+        int proof = attacker ? proof_infinity:0;
+        int disproof = attacker ? 0:proof_infinity;
+
+        // the most promising child and the second best number, which bounds how long it is searched
+        int best = 0;
+        int best_number = proof_infinity;
+        int second_number = proof_infinity;
+        int best_proof = 1, best_disproof = 1;
+
+        for(int ind = 0; ind < count; ind++){
+            int child_proof, child_disproof;
+            probeProof(keys[ind], plies - 1, child_proof, child_disproof);
+
+            // the mating side picks the move easiest to prove, the defender the one easiest to refute
+            int number = attacker ? child_proof:child_disproof;
+
+            if(attacker){
+                proof = std::min(proof, child_proof);
+                disproof = proofSum(disproof, child_disproof);
+            }else{
+                proof = proofSum(proof, child_proof);
+                disproof = std::min(disproof, child_disproof);
+            }
+
+            if(number < best_number){
+                second_number = best_number;
+                best_number = number;
+                best = ind;
+                best_proof = child_proof;
+                best_disproof = child_disproof;
+            }else if(number < second_number){
+                second_number = number;
+            }
+        }
+
+        if(proof >= proof_threshold || disproof >= disproof_threshold || stopped){
+            storeProof(key, plies, proof, disproof);
+            return;
+        }
+
+        // search the best child until it is no longer the best or this position reaches a threshold
+        int child_proof_threshold, child_disproof_threshold;
+
+        if(attacker){
+            child_proof_threshold = std::min(proof_threshold, proofSum(second_number, 1));
+            child_disproof_threshold = disproof_threshold - disproof + best_disproof;
+        }else{
+            child_proof_threshold = proof_threshold - proof + best_proof;
+            child_disproof_threshold = std::min(disproof_threshold, proofSum(second_number, 1));
+        }
+
+        boards.saveBoard();
+        boards.makeMove(moves[best], all);
+
+        proofSearch(boards, plies - 1, child_proof_threshold, child_disproof_threshold);
+
+        boards.restoreBoard();
+    }
+}
+
+// whether the side to move at the root mates within plies from this position
+bool Searcher::proveMate(BoardContainer boards, int plies){
+    if(plies < 0){
+        return false;
+    }
+
+    proofSearch(boards, plies, proof_infinity, proof_infinity);
+
+    int proof, disproof;
+    probeProof(boards.board.hashKey, plies, proof, disproof);
+
+    return proof == 0;
+}
+
+// appends the mating line of a position that is mated in exactly plies, the defender delays the mate as long as it can
+void Searcher::mateLine(BoardContainer boards, int plies, std::vector<std::string> &line){
+    if(plies == 0){
+        return;
+    }
+
+    bool attacker = boards.board.side == mate_side;
+
+    MoveList move_list;
+    boards.board.generateMoves(move_list);
+
+    Move chosen;
+
+    for(int ind = 0; ind < move_list.count && chosen.from == no_sq; ind++){
+        boards.saveBoard();
+
+        if(boards.makeMove(move_list.moves[ind], all) == 0){
+            continue;
+        }
+
+        // the mating side plays a move that still mates in time, the defender one after which
+        // the mate cannot come any sooner
+        if(attacker ? proveMate(boards, plies - 1):!proveMate(boards, plies - 3)){
+            chosen = move_list.moves[ind];
+        }
+
+        boards.restoreBoard();
+    }
+
+    // only reached when the search was stopped before the line was complete
+    if(chosen.from == no_sq){
+        return;
+    }
+
+    line.push_back(chosen.toString());
+
+    boards.saveBoard();
+    boards.makeMove(chosen, all);
+
+    mateLine(boards, plies - 1, line);
+}
+
+// looks for the shortest mate within mate_moves moves, one proof search per mate length
+SearchResult Searcher::solveMate(BoardContainer boards){
+    SearchResult result;
+
+    boards.table = NULL;
+
+    if(scheduler){
+        waitForCore();
+    }
+
+    nodes = 0;
+    mate_side = boards.board.side;
+
+    // results of earlier positions would only cost table slots
+    proof_table.assign(PROOF_TABLE_ENTRIES, ProofEntry());
+
+    int plies = 0;
+    bool found = false;
+
+    for(int moves = 1; moves <= mate_moves && !stopped; moves++){
+        plies = 2 * moves - 1;
+
+        if(proveMate(boards, plies)){
+            found = true;
+            break;
+        }
+    }
+
+    if(found){
+        std::vector<std::string> line;
+        mateLine(boards, plies, line);
+
+        result.depth = plies;
+        result.score = mate_value - plies;
+        result.mate = (plies + 1) / 2;
+        result.nodes = nodes;
+        result.time = get_time_ms() - starttime;
+        result.pv = line;
+
+        if(info_callback){
+            info_callback(result);
+        }
+    }
+
+    releaseCore();
+
+    // a ponder search may not report before "ponderhit" or "stop"
+    while(pondering && !stopped){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if(!result.pv.empty()){
+        result.bestMove = result.pv[0];
+    }else{
+        // no mate found, the move closest to a proof is the best guess
+        MoveList move_list;
+        boards.board.generateMoves(move_list);
+
+        int best_proof = proof_infinity + 1;
+
+        for(int ind = 0; ind < move_list.count; ind++){
+            boards.saveBoard();
+
+            if(boards.makeMove(move_list.moves[ind], all) == 0){
+                continue;
+            }
+
+            int proof, disproof;
+            probeProof(boards.board.hashKey, plies - 1, proof, disproof);
+
+            if(proof < best_proof){
+                best_proof = proof;
+                result.bestMove = move_list.moves[ind].toString();
+            }
+
+            boards.restoreBoard();
+        }
+    }
+
+    if(result.pv.size() > 1){
+        result.ponderMove = result.pv[1];
+    }
+
+    result.nodes = nodes;
+
+    return result;
+}
+
+/*----------------------------------*/
+/*                UCI               */
+/*----------------------------------*/
+
+// Decodes a move string directly from the board without generating moves, returns an empty move if
+// the side to move has no piece on the from square, the move is otherwise assumed pseudo-legal
+Move decodeMove(Chessboard &board, std::string moveString){
+    if(moveString.size() < 4){
+        return Move();
+    }
+
+    int from = (moveString[0] - 'a') + (8 - (moveString[1] - '0'))*8;
+    int to = (moveString[2] - 'a') + (8 - (moveString[3] - '0'))*8;
+
+    if(!validSquare(from) || !validSquare(to)){
+        return Move();
+    }
+
+    int piece = -1;
+
+    for(int ind = (board.side == White ? P:p); ind <= (board.side == White ? K:k); ind++){
+        if(getSquare(board.pieceBoards[ind], from)){
+            piece = ind;
+            break;
+        }
+    }
+
+    if(piece == -1){
+        return Move();
+    }
+
+    int flags = QUIET;
+
+    if(getSquare(board.occupancies[getEnemy(board.side)], to)){
+        flags |= CAPTURE;
+    }
+
+    int promotedPiece = 0;
+
+    if(piece == P || piece == p){
+        if(to == board.enpassant){
+            flags |= CAPTURE | ENPASSANT;
+        }else if(abs(to - from) == 16){
+            flags |= DOUBLE_PUSH;
+        }
+
+        if(moveString.size() > 4 && charToPiece.count(moveString[4])){
+            // promotion letters are lower case in UCI, the piece colour follows the side to move
+            promotedPiece = charToPiece.at(board.side == White ? toupper(moveString[4]):moveString[4]);
+        }
+    }
+
+    if((piece == K || piece == k) && abs(to - from) == 2){
+        flags |= CASTLE;
+    }
+
+    // a move onto one of our own pieces is never legal, neither is a fifth character that is not a pawn's promotion
+    if(getSquare(board.occupancies[board.side], to) || (moveString.size() > 4 && !promotedPiece)){
+        return Move();
+    }
+
+    bool pawn = (piece == P || piece == p);
+    bool last_rank = (board.side == White) ? (to < 8):(to >= 56);
+
+    // castling and promotions depend on rights, paths and ranks, they are rare enough to match against the generated moves
+    if((flags & CASTLE) || promotedPiece || (pawn && last_rank)){
+        MoveList move_list;
+        board.generateMoves(move_list);
+
+        for(int ind = 0; ind < move_list.count; ind++){
+            if(move_list.moves[ind].from == from && move_list.moves[ind].to == to && move_list.moves[ind].promotedPiece == promotedPiece){
+                return move_list.moves[ind];
+            }
+        }
+
+        return Move();
+    }
+
+    // every other move only has to follow its piece's movement, makeMove rejects those leaving the king in check
+    Bitboard occupied = board.occupancies[Both];
+    bool reachable;
+
+    if(pawn){
+        int forward = (board.side == White) ? -8:8;
+        bool start_rank = (board.side == White) ? (from >= 48):(from < 16);
+
+        if(flags & CAPTURE){
+            reachable = getSquare(pawn_attacks[board.side][from], to);
+        }else{
+            reachable = !getSquare(occupied, to) && (to == from + forward ||
+                (to == from + 2 * forward && start_rank && !getSquare(occupied, from + forward)));
+        }
+    }else{
+        // colourless piece type, black pieces follow the white ones
+        switch(piece % (numPieces / 2)){
+            case N: reachable = getSquare(knight_attacks[from], to); break;
+            case B: reachable = getSquare(getBishopAttacks(from, occupied), to); break;
+            case R: reachable = getSquare(getRookAttacks(from, occupied), to); break;
+            case Q: reachable = getSquare(getQueenAttacks(from, occupied), to); break;
+            default: reachable = getSquare(king_attacks[from], to); break;
+        }
+    }
+
+    if(!reachable){
+        return Move();
+    }
+
+    return Move(from, to, piece, promotedPiece, flags);
+}
+
+// One UCI conversation, either stdin/stdout or a server connection, with its own board, table and search
+class UciSession{
+    public:
+    BoardContainer boardState;
+
+    // UCI "debug" command and "Debug" option, prints the board and echoes the parsed input
+    bool debug_mode = false;
+
+    // transposition table and search state of the session
+    HashTable table;
+    Searcher search;
+
+    // base ("position startpos" or "position fen ...") and moves of the last position command,
+    // the board currently in boardState is the result of applying them
+    std::string position_base;
+    std::vector<std::string> position_moves;
+
+    // worker thread running the current "go"
+    std::thread search_thread;
+
+    // file used by the SaveHash and LoadHash options
+    std::string hash_file = "hash.bin";
+
+    // default of the Hash option
+    int hash_mb = DEFAULT_HASH_MB;
+
+    // MultiPV option, number of best moves reported
+    int multipv = 1;
+
+    // TraceFile and TraceSample options, the search is traced while a file is set
+    std::unique_ptr<SearchTracer> tracer;
+    int trace_sample = 1000;
+
+    // counters as of the last completed iteration, for the "stats" command
+    SearchStats last_stats;
+    std::mutex stats_mutex;
+
+    // replies are written here, the search thread and the session thread both write whole lines
+    int output_fd;
+    std::mutex output_mutex;
+
+    UciSession(int output_fd, int hash_mb, CoreScheduler *scheduler = NULL) : search(&table){
+        this->output_fd = output_fd;
+        this->hash_mb = hash_mb;
+
+        table.allocateHashTable(hash_mb);
+
+        search.scheduler = scheduler;
+        search.info_callback = [this](const SearchInfo &info){
+            printSearchInfo(info);
+
+#ifdef SEARCH_STATISTICS
+            // once per iteration, after its first line
+            if(info.multipv == 1){
+                send("info string " + search.stats.summary());
+
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                last_stats = search.stats;
+            }
+#endif
+        };
+    }
+
+    ~UciSession(){
+        stopSearch();
+    }
+
+    void send(const std::string &text);
+    void parsePosition(std::string command);
+    void joinSearch();
+    void stopSearch();
+    void printSearchInfo(const SearchInfo &result);
+    void runSearch(int depth, BoardContainer boards);
+    void parseGo(std::string command);
+    void parseOption(std::string command);
+    void printUciInfo();
+    void printStats();
+    bool command(std::string input);
+};
+
+// writes a line of output
+void UciSession::send(const std::string &text){
+    std::lock_guard<std::mutex> lock(output_mutex);
+
+    std::string line = text + "\n";
+    size_t written = 0;
+
+    while(written < line.size()){
+        ssize_t count = write(output_fd, line.data() + written, line.size() - written);
+
+        // the other end is gone, the session ends once its input does
+        if(count <= 0){
+            return;
+        }
+
+        written += count;
+    }
+}
+
+// Parses a given position string given by UCI protocol or user input
+// if the command extends the previous one, only the new moves are played on the current board
+void UciSession::parsePosition(std::string command){
+    size_t moves_index = command.find(" moves");
+
+    std::string base = command.substr(0, moves_index);
+
+    std::vector<std::string> moves;
+
+    if(moves_index != std::string::npos){
+        std::istringstream moveStream(command.substr(moves_index + 6));
+        std::string moveString;
+
+        while(moveStream >> moveString){
+            moves.push_back(moveString);
+        }
+    }
+
+    // number of moves already on the board
+    size_t played = 0;
+
+    if(base == position_base && moves.size() >= position_moves.size() && std::equal(position_moves.begin(), position_moves.end(), moves.begin())){
+        played = position_moves.size();
+    }else{
+        int ind = 9;
+        if(strncmp(&command[ind], "startpos", 8) == 0){
+            boardState.board = Chessboard(start_position);
+        }else if(strncmp(&command[ind], "fen", 3) == 0){
+            ind += 4;
+            boardState.board = Chessboard(&command[ind]);
+        }else{
+            boardState.board = Chessboard(start_position);
+        }
+    }
+
+    for(; played < moves.size(); played++){
+        Move move = decodeMove(boardState.board, moves[played]);
+
+        // if illegal
+        if(move.from == no_sq){
+            break;
+        }
+
+        boardState.board.repetition_table[boardState.board.rep_ind] = boardState.board.hashKey;
+        boardState.board.rep_ind++;
+
+        if(!boardState.makeMove(move, all)){
+            boardState.board.rep_ind--;
+            break;
+        }
+    }
+
+    position_base = base;
+    position_moves.assign(moves.begin(), moves.begin() + played);
+
+    if(debug_mode){
+        boardState.board.printChessboard();
+    }
+}
+
+// waits for the running search to finish, it prints its own bestmove
+void UciSession::joinSearch(){
+    if(search_thread.joinable()){
+        search_thread.join();
+    }
+}
+
+// stops the running search, if any, and waits for its bestmove
+void UciSession::stopSearch(){
+    search.stopped = true;
+    joinSearch();
+    search.pondering = false;
+}
+
+// prints a completed iteration, the line is built first and written at once since the UCI thread may print concurrently
+void UciSession::printSearchInfo(const SearchInfo &result){
+    std::ostringstream info;
+
+    // the multipv field is only sent when several lines are searched
+    if(multipv > 1){
+        info << "info multipv " << result.multipv;
+    }else{
+        info << "info";
+    }
+
+    if(result.mate){
+        info << " score mate " << result.mate;
+    }else{
+        info << " score cp " << result.score;
+    }
+
+    info << " depth " << result.depth << " nodes " << result.nodes << " time " << result.time
+        << " nps " << result.nodes * 1000 / std::max(result.time, 1) << " hashfull " << result.hashfull << " pv ";
+
+    for(const std::string &move : result.pv){
+        info << move << " ";
+    }
+
+    send(info.str());
+}
+
+// body of the search thread, searches and answers with bestmove
+void UciSession::runSearch(int depth, BoardContainer boards){
+    SearchResult result = search.searchPosition(depth, boards);
+
+    // "0000" is the UCI null move, sent when there is no legal move
+    std::string reply = "bestmove " + (result.bestMove.empty() ? std::string("0000"):result.bestMove);
+
+    if(!result.ponderMove.empty()){
+        reply += " ponder " + result.ponderMove;
+    }
+
+    send(reply);
+
+    // written after bestmove so the trace does not cost thinking time, the next "go" waits for this thread
+    if(tracer && !tracer->dump()){
+        send("info string failed to write trace to " + tracer->file_name);
+    }
+}
+
+// BlueFeverSoftware implementation
+// parse UCI go command
+void UciSession::parseGo(std::string command)
+{
+    // time control is set per "go", nothing carries over from the previous one
+    SearchLimits limits;
+
+    // init argument
+    char *argument = NULL;
+
+    // infinite search
+    if ((argument = strstr(&command[0],"infinite"))) {}
+
+    // ponder search, timing is set up as usual but only applies after "ponderhit"
+    limits.ponder = strstr(&command[0],"ponder") != NULL;
+
+    // match UCI "binc" command
+    if ((argument = strstr(&command[0],"binc"))){
+        // parse black time increment
+        limits.binc = atoi(argument + 5);
+    }
+    // match UCI "winc" command
+    if ((argument = strstr(&command[0],"winc"))){
+        // parse white time increment
+        limits.winc = atoi(argument + 5);
+    }
+
+    // match UCI "wtime" command
+    if ((argument = strstr(&command[0],"wtime"))){
+        // parse white time limit
+        limits.wtime = atoi(argument + 6);
+    }
+
+    // match UCI "btime" command
+    if ((argument = strstr(&command[0],"btime"))){
+        // parse black time limit
+        limits.btime = atoi(argument + 6);
+    }
+
+    // match UCI "movestogo" command
+    if ((argument = strstr(&command[0],"movestogo"))){
+        // parse number of moves to go
+        limits.movestogo = atoi(argument + 10);
+    }
+
+    // match UCI "movetime" command
+    if ((argument = strstr(&command[0],"movetime"))){
+        // parse amount of time allowed to spend to make a move
+        limits.movetime = atoi(argument + 9);
+    }
+
+    // match UCI "depth" command
+    if ((argument = strstr(&command[0],"depth"))){
+        // parse search depth
+        limits.depth = atoi(argument + 6);
+    }
+
+    // match UCI "nodes" command
+    if ((argument = strstr(&command[0],"nodes"))){
+        limits.nodes = strtoull(argument + 6, NULL, 10);
+    }
+
+    // match UCI "mate" command
+    if ((argument = strstr(&command[0],"mate"))){
+        limits.mate = atoi(argument + 5);
+    }
+
+    // match UCI "searchmoves" command
+    if ((argument = strstr(&command[0],"searchmoves"))){
+        std::istringstream moveStream(argument + 11);
+        std::string moveString;
+
+        // moves continue until the next token that is not a move
+        while(moveStream >> moveString){
+            if(moveString.size() < 4 || moveString[0] < 'a' || moveString[0] > 'h' || moveString[1] < '1' || moveString[1] > '8'){
+                break;
+            }
+
+            limits.searchmoves.push_back(moveString);
+        }
+    }
+
+    limits.multipv = multipv;
+
+    // init start time, soft and hard limits if time control is available
+    search.setLimits(limits, boardState.board.side);
+
+    // if depth is not available set depth to 64 plies (takes ages to complete...)
+    int depth = (limits.depth > 0) ? std::min(limits.depth, MAX_PLY):MAX_PLY;
+
+    // print debug info
+    if(debug_mode){
+        char info[128];
+        snprintf(info, sizeof(info), "time:%d start:%d soft:%d stop:%d depth:%d timeset:%d",
+        search.timeTracker, search.starttime.load(), search.soft_stoptime.load(), search.stoptime.load(), depth, search.timeset);
+        send(info);
+    }
+
+    // search position on the worker thread, the board is copied so the UCI loop may change it
+    search.stopped = false;
+    search_thread = std::thread(&UciSession::runSearch, this, depth, boardState);
+}
+
+// parse UCI setoption command
+void UciSession::parseOption(std::string command){
+    // init argument
+    char *argument = NULL;
+
+    // match UCI "Hash" option
+    if ((argument = strstr(&command[0],"name Hash value"))){
+        // resize the transposition table, which also clears it, a size that does not fit keeps the current table
+        try{
+            table.allocateHashTable(atoi(argument + 16));
+        }catch(std::bad_alloc &){
+            send("info string cannot allocate " + std::to_string(atoi(argument + 16)) + " MB of hash, keeping " + std::to_string(table.hash_bytes >> 20) + " MB");
+        }
+    }
+
+    // match UCI "Move Overhead" option
+    if ((argument = strstr(&command[0],"name Move Overhead value"))){
+        search.move_overhead = std::max(0, atoi(argument + 25));
+    }
+
+    // match UCI "MultiPV" option
+    if ((argument = strstr(&command[0],"name MultiPV value"))){
+        multipv = std::max(1, std::min(atoi(argument + 19), MAX_MULTIPV));
+    }
+
+    // match UCI "TraceSample" option
+    if ((argument = strstr(&command[0],"name TraceSample value"))){
+        trace_sample = std::max(1, atoi(argument + 23));
+
+        if(tracer){
+            tracer->sample = trace_sample;
+        }
+    }
+
+    // match UCI "TraceFile" option, an empty value turns tracing off
+    if ((argument = strstr(&command[0],"name TraceFile value"))){
+        std::string file_name = argument[20] ? argument + 21:"";
+
+        if(file_name.empty() || file_name == "<empty>"){
+            tracer.reset();
+        }else{
+            tracer.reset(new SearchTracer(file_name, trace_sample));
+        }
+
+        search.tracer = tracer.get();
+    }
+
+    // match UCI "Debug" option
+    if ((argument = strstr(&command[0],"name Debug value"))){
+        debug_mode = strncmp(argument + 17, "true", 4) == 0;
+    }
+
+    // match UCI "HashFile" option
+    if ((argument = strstr(&command[0],"name HashFile value"))){
+        hash_file = argument + 20;
+    }
+
+    // match UCI "SaveHash" button
+    if (strstr(&command[0],"name SaveHash")){
+        send("info string " + std::string(table.saveHashTable(hash_file) ? "saved hash to ":"failed to save hash to ") + hash_file);
+    }
+
+    // match UCI "LoadHash" button
+    if (strstr(&command[0],"name LoadHash")){
+        send("info string " + std::string(table.loadHashTable(hash_file) ? "loaded hash from ":"failed to load hash from ") + hash_file);
+    }
+}
+
+// prints the engine identity and supported options in reply to "uci"
+void UciSession::printUciInfo(){
+    send("id name BitboardChessEngine");
+    send("id author CW");
+    send("option name Hash type spin default " + std::to_string(hash_mb) + " min 1 max " + std::to_string(MAX_HASH_MB));
+    send("option name HashFile type string default hash.bin");
+    send("option name SaveHash type button");
+    send("option name LoadHash type button");
+    send("option name Ponder type check default false");
+    send("option name Move Overhead type spin default 50 min 0 max 5000");
+    send("option name MultiPV type spin default 1 min 1 max " + std::to_string(MAX_MULTIPV));
+    send("option name TraceFile type string default <empty>");
+    send("option name TraceSample type spin default 1000 min 1 max 1000000000");
+    send("option name Debug type check default false");
+    send("uciok");
+}
+
+// prints the counters of the last completed iteration in reply to "stats"
+void UciSession::printStats(){
+#ifdef SEARCH_STATISTICS
+    SearchStats stats;
+
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        stats = last_stats;
+    }
+
+    char line[256];
+    unsigned long long total_nodes = stats.main_nodes + stats.quiescence_nodes;
+
+    snprintf(line, sizeof(line), "info string nodes %llu main %llu (%.1f%%) quiescence %llu (%.1f%%)", total_nodes,
+        stats.main_nodes, SearchStats::rate(stats.main_nodes, total_nodes), stats.quiescence_nodes, SearchStats::rate(stats.quiescence_nodes, total_nodes));
+    send(line);
+
+    snprintf(line, sizeof(line), "info string tt probes %llu hits %llu (%.1f%%) cutoffs %llu (%.1f%%)", stats.tt_probes,
+        stats.tt_hits, SearchStats::rate(stats.tt_hits, stats.tt_probes), stats.tt_cutoffs, SearchStats::rate(stats.tt_cutoffs, stats.tt_probes));
+    send(line);
+
+    snprintf(line, sizeof(line), "info string fail-highs %llu on the first move %llu (%.1f%%)", stats.fail_highs,
+        stats.first_move_fail_highs, SearchStats::rate(stats.first_move_fail_highs, stats.fail_highs));
+    send(line);
+
+    snprintf(line, sizeof(line), "info string null move tries %llu cutoffs %llu (%.1f%%)", stats.null_tries,
+        stats.null_cutoffs, SearchStats::rate(stats.null_cutoffs, stats.null_tries));
+    send(line);
+
+    snprintf(line, sizeof(line), "info string lmr tries %llu re-searches %llu (%.1f%%), pvs tries %llu re-searches %llu (%.1f%%)", stats.lmr_tries,
+        stats.lmr_researches, SearchStats::rate(stats.lmr_researches, stats.lmr_tries),
+        stats.pvs_tries, stats.pvs_researches, SearchStats::rate(stats.pvs_researches, stats.pvs_tries));
+    send(line);
+
+    for(int depth = 1; depth <= stats.last_depth; depth++){
+        snprintf(line, sizeof(line), "info string depth %d nodes %llu ebf %.2f", depth, stats.depth_nodes[depth], stats.branchingFactor(depth));
+        send(line);
+    }
+#else
+    send("info string search statistics are not compiled in, build with -DSEARCH_STATISTICS (make stats)");
+#endif
+}
+
+// handles one line of input, returns false once the session should end
+bool UciSession::command(std::string input){
+    if(debug_mode){
+        send("Parsing input: " + input);
+    }
+
+    if(input.empty()){
+        return true;
+    }
+    
+    // UCI isready command, answered right away even while searching
+    if(strncmp(&input[0], "isready", 7) == 0){
+        send("readyok");
+        return true;
+    }
+
+    // UCI stop command, the search prints its bestmove before it finishes
+    if(strncmp(&input[0], "stop", 4) == 0){
+        stopSearch();
+        return true;
+    }
+    
+    // UCI ponderhit command
+    if(strncmp(&input[0], "ponderhit", 9) == 0){
+        search.ponderHit();
+        return true;
+    }
+    
+    // UCI position command
+    if(strncmp(&input[0], "position", 8) == 0){
+        stopSearch();
+        parsePosition(input);
+        return true;
+    }
+
+    // UCI new game command, forgets everything learned from earlier searches
+    if(strncmp(&input[0], "ucinewgame", 10) == 0){
+        stopSearch();
+        parsePosition("position startpos");
+        table.clearHashTable();
+        search.clearHistory();
+        return true;
+    }
+
+    // UCI go command
+    if(strncmp(&input[0], "go", 2) == 0){
+        stopSearch();
+        parseGo(input);
+        return true;
+    }
+    
+    // UCI quit command
+    if(strncmp(&input[0], "quit", 4) == 0){
+        stopSearch();
+        return false;
+    }
+
+    // UCI debug command
+    if(strncmp(&input[0], "debug", 5) == 0){
+        debug_mode = strncmp(&input[0], "debug on", 8) == 0;
+        return true;
+    }
+
+    // UCI setoption command
+    if(strncmp(&input[0], "setoption", 9) == 0){
+        stopSearch();
+        parseOption(input);
+        return true;
+    }
+
+    // UCI uci command
+    if(strncmp(&input[0], "uci", 3) == 0){
+        printUciInfo();
+        return true;
+    }
+
+    // search statistics of the last iteration, not part of UCI
+    if(strncmp(&input[0], "stats", 5) == 0){
+        printStats();
+        return true;
+    }
+
+    return true;
+}
+
+// main UCI program
+void uciLoop(){
+    setbuf(stdin, NULL);
+    setbuf(stdout, NULL);
+
+    // the session holds the search tables, too large for the stack
+    std::unique_ptr<UciSession> session(new UciSession(STDOUT_FILENO, DEFAULT_HASH_MB));
+
+    session->printUciInfo();
+
+    startInputThread();
+
+    while(session->command(nextInputLine())){}
+}
+
+/*----------------------------------*/
+/*              SERVER              */
+/*----------------------------------*/
+
+// Shares a fixed number of cores between the searches of all sessions. Searches get a core in the order
+// they asked for one and give it back after core_time_slice whenever another search is waiting, so every
+// running "go" gets an equal share of the cores.
+class CoreScheduler{
+    public:
+    int budget = 1;
+    int running = 0;
+
+    // searches waiting for a core, the front one is served next
+    std::deque<const Searcher *> waiting;
+
+    std::mutex mutex;
+    std::condition_variable available;
+
+    CoreScheduler(int budget){
+        this->budget = std::max(1, budget);
+    }
+
+    void enqueue(const Searcher *search){
+        std::lock_guard<std::mutex> lock(mutex);
+        waiting.push_back(search);
+    }
+
+    // waits up to timeout ms for the search's turn, returns true once it holds a core
+    bool take(const Searcher *search, int timeout){
+        std::unique_lock<std::mutex> lock(mutex);
+
+        bool turn = available.wait_for(lock, std::chrono::milliseconds(timeout), [&](){
+            return running < budget && waiting.front() == search;
+        });
+
+        if(turn){
+            waiting.pop_front();
+            running++;
+        }
+
+        return turn;
+    }
+
+    // gives up a place in the queue
+    void leave(const Searcher *search){
+        std::lock_guard<std::mutex> lock(mutex);
+        waiting.erase(std::find(waiting.begin(), waiting.end(), search));
+        available.notify_all();
+    }
+
+    void release(){
+        std::lock_guard<std::mutex> lock(mutex);
+        running--;
+        available.notify_all();
+    }
+
+    bool contended(){
+        std::lock_guard<std::mutex> lock(mutex);
+        return !waiting.empty();
+    }
+};
+
+// queues for a core, a search that is stopped while waiting runs to its end without one
+void Searcher::waitForCore(){
+    scheduler->enqueue(this);
+
+    while(!scheduler->take(this, 5)){
+        // the clock keeps running while waiting
+        communicate();
+
+        if(stopped){
+            scheduler->leave(this);
+            return;
+        }
+    }
+
+    holding_core = true;
+    slice_start = get_time_ms();
+}
+
+// hands the core to the next waiting search at the end of a time slice
+void Searcher::yieldCore(){
+    if(!scheduler->contended()){
+        slice_start = get_time_ms();
+        return;
+    }
+
+    releaseCore();
+    waitForCore();
+}
+
+void Searcher::releaseCore(){
+    if(holding_core){
+        holding_core = false;
+        scheduler->release();
+    }
+}
+
+#ifndef _WIN32
+// reads the next line from a socket into line, returns false once the peer closed the connection
+static bool readSocketLine(int fd, std::string &buffer, std::string &line){
+    size_t end;
+
+    while((end = buffer.find('\n')) == std::string::npos){
+        char chunk[4096];
+        ssize_t count = read(fd, chunk, sizeof(chunk));
+
+        if(count <= 0){
+            return false;
+        }
+
+        buffer.append(chunk, count);
+    }
+
+    line = buffer.substr(0, end);
+    buffer.erase(0, end + 1);
+
+    // clients on Windows end lines with CRLF
+    if(!line.empty() && line.back() == '\r'){
+        line.pop_back();
+    }
+
+    return true;
+}
+
+// runs one UCI session on a connection until the client sends "quit" or disconnects
+void serveSession(int fd, CoreScheduler *scheduler, int hash_mb){
+    try{
+        std::unique_ptr<UciSession> session(new UciSession(fd, hash_mb, scheduler));
+
+        std::string buffer, line;
+
+        while(readSocketLine(fd, buffer, line) && session->command(line)){}
+    }catch(std::bad_alloc &){
+        // the other sessions keep running if this one's table does not fit
+    }
+
+    close(fd);
+}
+
+// listens on a loopback TCP port if address is a number, otherwise on a Unix domain socket at that path
+static int openServerSocket(std::string address){
+    bool tcp = !address.empty() && address.find_first_not_of("0123456789") == std::string::npos;
+    int fd = socket(tcp ? AF_INET:AF_UNIX, SOCK_STREAM, 0);
+
+    if(fd < 0){
+        return -1;
+    }
+
+    int bound;
+
+    if(tcp){
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(atoi(address.c_str()));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        bound = bind(fd, (sockaddr *)&addr, sizeof(addr));
+    }else{
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+
+        // a socket file left behind by an earlier server
+        unlink(address.c_str());
+
+        bound = bind(fd, (sockaddr *)&addr, sizeof(addr));
+    }
+
+    if(bound < 0 || listen(fd, SOMAXCONN) < 0){
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// accepts UCI sessions until the process is killed, all sessions share threads cores for searching
+void runServer(std::string address, int threads, int hash_mb){
+    // a client disconnecting mid-reply must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = openServerSocket(address);
+
+    if(listener < 0){
+        std::cout << "failed to listen on " << address << std::endl;
+        return;
+    }
+
+    // port 0 lets the OS pick a free port, the banner names the one it picked
+    sockaddr_in bound = {};
+    socklen_t length = sizeof(bound);
+
+    if(getsockname(listener, (sockaddr *)&bound, &length) == 0 && bound.sin_family == AF_INET){
+        address = std::to_string(ntohs(bound.sin_port));
+    }
+
+    std::cout << "listening on " << address << " with " << threads << " search threads" << std::endl;
+
+    // outlives the detached sessions using it
+    CoreScheduler *scheduler = new CoreScheduler(threads);
+
+    while(true){
+        int fd = accept(listener, NULL, NULL);
+
+        if(fd < 0){
+            if(errno == EINTR || errno == ECONNABORTED){
+                continue;
+            }
+
+            break;
+        }
+
+        std::thread(serveSession, fd, scheduler, hash_mb).detach();
+    }
+
+    close(listener);
+}
+#endif
+
+/*----------------------------------*/
+/*           EPD ANALYSIS           */
+/*----------------------------------*/
+
+// reads the position file, one FEN or EPD line per position, and returns its positions,
+// lines gets the line of the file each position came from since blank, comment and malformed lines are skipped
+static std::vector<std::string> readPositions(std::string fileName, std::vector<int> &lines){
+    std::ifstream file(fileName);
+    std::vector<std::string> positions;
+    std::string line;
+    int line_number = 0;
+
+    while(std::getline(file, line)){
+        std::istringstream fields(line);
+        std::string board, side, castle, enpassant;
+
+        line_number++;
+
+        // comments start with # or ;, a board needs its 8 ranks, EPD operations after the first four fields are ignored
+        if(fields >> board >> side >> castle >> enpassant && board[0] != '#' && board[0] != ';' && std::count(board.begin(), board.end(), '/') == 7){
+            positions.push_back(board + " " + side + " " + castle + " " + enpassant + " 0 1");
+            lines.push_back(line_number);
+        }
+    }
+
+    return positions;
+}
+
+// formats a score the way UCI reports it
+static std::string scoreString(const SearchInfo &info){
+    return info.mate ? "mate " + std::to_string(info.mate):"cp " + std::to_string(info.score);
+}
+
+// searches every position within limits, one engine per thread, onResult is called for each position
+// as it finishes, one call at a time
+static void analysePositions(const std::vector<std::string> &positions, const SearchLimits &limits, int threads, int hash_mb,
+    std::function<void(int index, const SearchResult &result)> onResult){
+    // next position to hand out
+    std::atomic<int> next(0);
+    std::mutex result_mutex;
+
+    auto worker = [&](){
+        Engine engine(hash_mb);
+
+        for(int index = next++; index < (int)positions.size(); index = next++){
+            // every position starts from empty tables so results do not depend on which thread got what
+            engine.newGame();
+
+            SearchResult result = engine.search(Position(positions[index]), limits);
+
+            std::lock_guard<std::mutex> lock(result_mutex);
+            onResult(index, result);
+        }
+    };
+
+    std::vector<std::thread> workers;
+
+    for(int thread = 0; thread < std::max(1, std::min(threads, (int)positions.size())); thread++){
+        workers.emplace_back(worker);
+    }
+
+    for(std::thread &thread : workers){
+        thread.join();
+    }
+}
+
+// analyses every position of the file within limits and prints each result as it finishes:
+// line number in the file, fen, best move, score, depth and nodes, tab-separated like the coordinator's results
+void runBatch(std::string fileName, const SearchLimits &limits, int threads, int hash_mb){
+    std::vector<int> lines;
+    std::vector<std::string> positions = readPositions(fileName, lines);
+
+    int start = get_time_ms();
+
+    analysePositions(positions, limits, threads, hash_mb, [&](int index, const SearchResult &result){
+        printf("%d\t%s\t%s\t%s\t%d\t%llu\n", lines[index], positions[index].c_str(), result.bestMove.empty() ? "0000":result.bestMove.c_str(),
+            scoreString(result).c_str(), result.depth, result.nodes);
+        fflush(stdout);
+    });
+
+    fprintf(stderr, "analysed %d positions in %d ms\n", (int)positions.size(), get_time_ms() - start);
+}
+
+/*----------------------------------*/
+/*       PERFORMANCE COUNTERS       */
+/*----------------------------------*/
+
+// hardware events counted by "profile", in the order they are reported
+enum { perf_cycles, perf_instructions, perf_l1d_misses, perf_llc_misses, perf_branch_misses, perf_dtlb_misses, perf_counter_count };
+
+static const char *perf_counter_names[perf_counter_count] = {
+    "cycles", "instructions", "L1d misses", "LLC misses", "branch misses", "dTLB misses"
+};
+
+// Hardware performance counters of this process and the threads it starts, read through perf_event_open on Linux.
+// Counters the CPU, kernel or virtual machine does not provide are left out of the report.
+class PerfCounters{
+    public:
+    // file descriptor of every counter, -1 if it could not be opened
+    int fds[perf_counter_count];
+
+    // counts of the last start/stop interval, scaled up if the kernel had to multiplex the counters
+    unsigned long long values[perf_counter_count] = {0};
+
+    PerfCounters(){
+        for(int counter = 0; counter < perf_counter_count; counter++){
+            fds[counter] = -1;
         }
+    }
 
-        // fount a better move
-        if(score > alpha){
-            // PV node
-            alpha = score;
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
 
-            // fail hard beta cutoff, node fails high
-            if(score >= beta){
-                return beta;
+    ~PerfCounters(){
+        for(int counter = 0; counter < perf_counter_count; counter++){
+            if(fds[counter] >= 0){
+                close(fds[counter]);
+            }
+        }
+    }
+
+    // opens every counter disabled, returns false if none is available
+    bool open(){
+        bool available = false;
+
+#ifdef __linux__
+        const unsigned int types[perf_counter_count] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE
+        };
+
+        // cache events are encoded as cache | operation << 8 | result << 16
+        const unsigned long long configs[perf_counter_count] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+        };
+
+        for(int counter = 0; counter < perf_counter_count; counter++){
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+
+            attr.size = sizeof(attr);
+            attr.type = types[counter];
+            attr.config = configs[counter];
+            attr.disabled = 1;
+
+            // threads started later, like bench's workers, are counted too
+            attr.inherit = 1;
+
+            // user space only, which is also all an unprivileged process may count
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            fds[counter] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            available |= fds[counter] >= 0;
+        }
+#endif
+
+        return available;
+    }
+
+    void start(){
+#ifdef __linux__
+        for(int counter = 0; counter < perf_counter_count; counter++){
+            if(fds[counter] >= 0){
+                ioctl(fds[counter], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[counter], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    void stop(){
+#ifdef __linux__
+        for(int counter = 0; counter < perf_counter_count; counter++){
+            if(fds[counter] < 0){
+                continue;
+            }
+
+            ioctl(fds[counter], PERF_EVENT_IOC_DISABLE, 0);
+
+            // value, time enabled, time running
+            unsigned long long data[3] = {0};
+
+            if(read(fds[counter], data, sizeof(data)) != sizeof(data) || data[2] == 0){
+                values[counter] = 0;
+                continue;
+            }
+
+            values[counter] = (unsigned long long)((double)data[0] * data[1] / data[2]);
+        }
+#endif
+    }
+
+    // prints every available counter in total and per node
+    void report(unsigned long long nodes){
+        printf("\n%-16s %16s %12s\n", "counter", "total", "per node");
+
+        for(int counter = 0; counter < perf_counter_count; counter++){
+            if(fds[counter] < 0){
+                printf("%-16s %16s\n", perf_counter_names[counter], "not supported");
+                continue;
             }
+
+            printf("%-16s %16llu %12.2f\n", perf_counter_names[counter], values[counter], (double)values[counter] / std::max(nodes, 1ULL));
+        }
+
+        if(fds[perf_cycles] >= 0 && fds[perf_instructions] >= 0 && values[perf_cycles]){
+            printf("%-16s %16.2f\n", "IPC", (double)values[perf_instructions] / values[perf_cycles]);
         }
     }
+};
+
+/*----------------------------------*/
+/*             BENCHMARK            */
+/*----------------------------------*/
+
+// Openings, middlegames, endgames and a few mates and stalemates, searched to a fixed depth by "bench"
+static const std::vector<std::string> bench_positions = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "rnbqkb1r/pp1p1ppp/4pn2/2p5/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 0 4",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+    "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+    "8/8/8/4k3/8/8/4P3/4K3 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/8/8/8/8/6k1/6p1/6K1 w - - 0 1",
+    "7k/7P/6K1/8/3B4/8/8/8 b - - 0 1",
+};
+
+// searches every bench position to depth from empty tables, the total node count is a signature of the search
+// that changes with any change to move generation, evaluation or pruning, prints it with the time and speed,
+// and with profile the hardware counters of the run
+void runBench(int depth, int threads, int hash_mb, bool profile){
+    SearchLimits limits;
+    limits.depth = depth;
+
+    unsigned long long total_nodes = 0;
+
+    PerfCounters counters;
+
+    if(profile && !counters.open()){
+        fprintf(stderr, "hardware performance counters are not available\n");
+        profile = false;
+    }
 
-    return alpha;
+    int start = get_time_ms();
+
+    if(profile){
+        counters.start();
+    }
+
+    analysePositions(bench_positions, limits, threads, hash_mb, [&](int index, const SearchResult &result){
+        total_nodes += result.nodes;
+
+        fprintf(stderr, "position %2d/%d: %s nodes %llu\n", index + 1, (int)bench_positions.size(),
+            result.bestMove.empty() ? "0000":result.bestMove.c_str(), result.nodes);
+    });
+
+    if(profile){
+        counters.stop();
+    }
+
+    int elapsed = std::max(get_time_ms() - start, 1);
+
+    std::cout << "Total time (ms) : " << elapsed << std::endl;
+    std::cout << "Nodes searched  : " << total_nodes << std::endl;
+    std::cout << "Nodes/second    : " << total_nodes * 1000 / elapsed << std::endl;
+
+    if(profile){
+        counters.report(total_nodes);
+    }
 }
 
-const int full_depth_moves = 4;
-const int reduction_limit = 3;
+// counts the leaf nodes of the position to depth like perftDriver, prints them with the time and speed,
+// and with profile the hardware counters of the run
+void runPerft(int depth, std::string fen, bool profile){
+    BoardContainer boards(fen);
 
-// negamax alpha beta search
-static inline int negamax(int alpha, int beta, int depth, BoardContainer boards){    
-    // static evaluation score
-    int score;
+    PerfCounters counters;
 
-    int hashFlag = hashFlagAlpha;
+    if(profile && !counters.open()){
+        fprintf(stderr, "hardware performance counters are not available\n");
+        profile = false;
+    }
 
-    // if repeated position
-    if(ply && is_repeated(boards)){
-        return 0;
+    memset(node_count, 0, sizeof(node_count));
+
+    int start = get_time_ms();
+
+    if(profile){
+        counters.start();
     }
 
-    // Checks if current node is a pv node
-    bool isPV = (beta - alpha) > 1;
-    
-    // check if move has already been searched (is in transposition table)
-    if(ply && (score = readHashEntry(alpha, beta, depth, boards.board.hashKey)) != NOT_FOUND && !isPV){
-        return score;
+    perftDriver(depth, boards);
+
+    if(profile){
+        counters.stop();
     }
 
-    // Check gui input every 2047 nodes
-    if((nodes & 2047) == 0){
-        communicate();
+    int elapsed = std::max(get_time_ms() - start, 1);
+
+    std::cout << "Total time (ms) : " << elapsed << std::endl;
+    std::cout << "Nodes           : " << node_count[0] << std::endl;
+    std::cout << "Nodes/second    : " << node_count[0] * 1000 / elapsed << std::endl;
+
+    if(profile){
+        counters.report(node_count[0]);
     }
+}
 
-    // init pv length
-    pv_length[ply] = ply;
+/*----------------------------------*/
+/*         MICRO BENCHMARKS         */
+/*----------------------------------*/
 
-    // escape condition
-    if(depth == 0){
-        return quiescence(alpha, beta, boards);
+// Times the primitives of the search in isolation over a fixed corpus of positions, so a change in bench
+// speed can be traced to the primitive that caused it
+
+// plies of the random playout from every bench position, each position along it joins the corpus
+#define MICRO_CORPUS_PLIES 20
+
+// untimed runs before the measured repetitions, to fill the caches and branch predictors
+#define MICRO_WARMUP_RUNS 2
+
+// keeps the compiler from removing the measured work
+static volatile unsigned long long micro_sink = 0;
+
+// positions reached by deterministic random playouts from the bench positions
+static std::vector<BoardContainer> microCorpus(){
+    std::vector<BoardContainer> corpus;
+
+    // own generator, the global one would change the state the zobrist keys were made from
+    unsigned int seed = RANDOM_SEED;
+
+    for(const std::string &fen : bench_positions){
+        BoardContainer boards(fen);
+
+        for(int ply = 0; ply < MICRO_CORPUS_PLIES; ply++){
+            corpus.push_back(boards);
+
+            MoveList move_list;
+            boards.board.generateMoves(move_list);
+
+            Move legal[256];
+            int count = 0;
+
+            for(int ind = 0; ind < move_list.count; ind++){
+                if(boards.makeMove(move_list.moves[ind], all)){
+                    legal[count++] = move_list.moves[ind];
+                    boards.restoreBoard();
+                }
+            }
+
+            if(count == 0){
+                break;
+            }
+
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+
+            boards.makeMove(legal[seed % count], all);
+        }
     }
 
-    // ply overflow handling
-    if(ply > MAX_PLY - 1){
-        return evaluate(boards);
+    return corpus;
+}
+
+// runs body, which performs ops operations and returns a checksum, and prints the median, fastest and slowest
+// time per operation over the repetitions with their standard deviation
+static void microBenchmark(const char *name, unsigned long long ops, int repetitions, std::function<unsigned long long()> body){
+    for(int run = 0; run < MICRO_WARMUP_RUNS; run++){
+        micro_sink += body();
     }
 
-    nodes++;
+    std::vector<double> samples;
 
-    int in_check = boards.board.isAttacked((boards.board.side == White) ? findLSB(boards.board.pieceBoards[K]):findLSB(boards.board.pieceBoards[k]), boards.board.side^1);
+    for(int run = 0; run < repetitions; run++){
+        auto start = std::chrono::steady_clock::now();
+        micro_sink += body();
+        auto end = std::chrono::steady_clock::now();
 
-    // increase depth if king in check
-    if(in_check){
-        depth++;
+        samples.push_back(std::chrono::duration<double, std::nano>(end - start).count() / ops);
     }
 
-    int legal_moves = 0;
+    std::sort(samples.begin(), samples.end());
 
-    // null move pruning
-    if(depth >= 3 && in_check == 0 && ply){
-        boards.saveBoard();
+    double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / repetitions;
+    double variance = 0;
 
-        ply++;
+    for(double sample : samples){
+        variance += (sample - mean) * (sample - mean);
+    }
 
-        boards.board.repetition_table[boards.board.rep_ind] = boards.board.hashKey;
-        boards.board.rep_ind++;
+    printf("%-16s %10.2f %10.2f %10.2f %9.1f%%\n", name, samples[repetitions / 2], samples.front(), samples.back(),
+        100 * sqrt(variance / repetitions) / mean);
+}
 
-        // Give enemy an extra move
-        boards.board.side ^= 1; 
-        // Update hash key
-        boards.board.hashKey ^= side_key;
+// times every primitive repetitions times over the corpus
+void runMicroBench(int repetitions){
+    std::vector<BoardContainer> corpus = microCorpus();
 
-        if(boards.board.enpassant != no_sq){
-            boards.board.hashKey ^= enpassant_keys[boards.board.enpassant];
+    // the moves of every corpus position, generated once for the benchmarks that consume them
+    std::vector<MoveList> move_lists(corpus.size());
+    unsigned long long move_count = 0;
+
+    for(int pos = 0; pos < (int)corpus.size(); pos++){
+        corpus[pos].board.generateMoves(move_lists[pos]);
+        move_count += move_lists[pos].count;
+    }
+
+    // large enough to live on the heap, its history tables start empty
+    HashTable table;
+    std::unique_ptr<Searcher> search(new Searcher(&table));
+
+    unsigned long long positions = corpus.size();
+
+    printf("%llu positions, %llu moves, %d repetitions\n\n", positions, move_count, repetitions);
+    printf("%-16s %10s %10s %10s %10s\n", "primitive", "ns/op", "min", "max", "stddev");
+
+    microBenchmark("generateMoves", positions, repetitions, [&](){
+        unsigned long long sum = 0;
+        MoveList move_list;
+
+        for(BoardContainer &boards : corpus){
+            boards.board.generateMoves(move_list);
+            sum += move_list.count;
         }
 
-        boards.board.enpassant = no_sq;
+        return sum;
+    });
 
-        // Find beta cutoffs within depth - 1 - R moves
-        score = -negamax(-beta, -beta + 1, depth - 1 - 2, boards);
+    microBenchmark("makeMove", move_count, repetitions, [&](){
+        unsigned long long sum = 0;
 
-        ply--;
+        for(int pos = 0; pos < (int)corpus.size(); pos++){
+            BoardContainer &boards = corpus[pos];
 
-        boards.board.rep_ind--;
+            for(int ind = 0; ind < move_lists[pos].count; ind++){
+                // an illegal move is undone by makeMove itself
+                if(boards.makeMove(move_lists[pos].moves[ind], all)){
+                    sum += boards.board.hashKey;
+                    boards.restoreBoard();
+                }
+            }
+        }
 
-        boards.restoreBoard();
+        return sum;
+    });
 
-        // time is up
-        if(stopped){
-            return 0;
+    microBenchmark("evaluate", positions, repetitions, [&](){
+        unsigned long long sum = 0;
+
+        for(BoardContainer &boards : corpus){
+            sum += evaluate(boards);
         }
 
-        // beta cutoff
-        if(score >= beta){
-            return beta;
+        return sum;
+    });
+
+    microBenchmark("isAttacked", positions * numSquares, repetitions, [&](){
+        unsigned long long sum = 0;
+
+        for(BoardContainer &boards : corpus){
+            for(int square = 0; square < numSquares; square++){
+                sum += boards.board.isAttacked(square, boards.board.side);
+            }
+        }
+
+        return sum;
+    });
+
+    microBenchmark("getRookAttacks", positions * numSquares, repetitions, [&](){
+        unsigned long long sum = 0;
+
+        for(BoardContainer &boards : corpus){
+            for(int square = 0; square < numSquares; square++){
+                sum += getRookAttacks(square, boards.board.occupancies[Both]);
+            }
+        }
+
+        return sum;
+    });
+
+    microBenchmark("getBishopAttacks", positions * numSquares, repetitions, [&](){
+        unsigned long long sum = 0;
+
+        for(BoardContainer &boards : corpus){
+            for(int square = 0; square < numSquares; square++){
+                sum += getBishopAttacks(square, boards.board.occupancies[Both]);
+            }
+        }
+
+        return sum;
+    });
+
+    microBenchmark("scoreMove", move_count, repetitions, [&](){
+        unsigned long long sum = 0;
+
+        for(int pos = 0; pos < (int)corpus.size(); pos++){
+            for(int ind = 0; ind < move_lists[pos].count; ind++){
+                sum += search->scoreMove(move_lists[pos].moves[ind], corpus[pos]);
+            }
+        }
+
+        return sum;
+    });
+
+    microBenchmark("sortMoves", positions, repetitions, [&](){
+        unsigned long long sum = 0;
+        MoveList move_list;
+
+        for(int pos = 0; pos < (int)corpus.size(); pos++){
+            // sorted in place, so every run starts from the generated order
+            move_list.count = move_lists[pos].count;
+            std::copy(move_lists[pos].moves, move_lists[pos].moves + move_list.count, move_list.moves);
+
+            search->sortMoves(move_list, corpus[pos]);
+            sum += move_list.moves[0].to;
         }
+
+        return sum;
+    });
+}
+
+/*----------------------------------*/
+/*           TRACE READER           */
+/*----------------------------------*/
+
+// most subtrees listed by size in a trace summary
+#define TRACE_TOP_SUBTREES 10
+
+// reads a file written by SearchTracer, returns false if it is not a trace of this build
+static bool readTrace(std::string fileName, TraceHeader &header, std::vector<TraceRecord> &records){
+    FILE *file = fopen(fileName.c_str(), "rb");
+
+    if(file == NULL){
+        return false;
     }
 
-    MoveList move_list;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, TraceHeader().magic, sizeof(header.magic)) == 0 &&
+        header.record_size == sizeof(TraceRecord);
 
-    boards.board.generateMoves(move_list);
+    // the count must fit the file, a corrupt header would otherwise ask for any amount of memory
+    long start = ftell(file);
+    ok = ok && fseek(file, 0, SEEK_END) == 0;
+    long size = ftell(file);
 
-    if(follow_pv){
-        // enable pv move scoring
-        enablePVScoring(move_list);
+    if(ok && size >= start && header.count <= (uint64_t)(size - start) / sizeof(TraceRecord)){
+        fseek(file, start, SEEK_SET);
+        records.resize(header.count);
+        ok = fread(records.data(), sizeof(TraceRecord), header.count, file) == header.count;
+    }else{
+        ok = false;
     }
 
-    sortMoves(move_list, boards);
+    fclose(file);
 
-    // number of moves searched in a move list
-    int moves_searched = 0;
+    return ok;
+}
 
-    for(int ind = 0; ind < move_list.count; ind++){
-        boards.saveBoard();
+// UCI notation of a traced move, "root" for the first node of a search and "null" for a null move
+static std::string traceMoveString(const TraceRecord &record){
+    if(record.move == 0){
+        return record.ply ? "null":"root";
+    }
 
-        ply++;
+    return Move(record.move & 63, (record.move >> 6) & 63, 0, record.move >> 12, 0).toString();
+}
 
-        boards.board.repetition_table[boards.board.rep_ind] = boards.board.hashKey;
-        boards.board.rep_ind++;
+static void printTraceNode(const std::vector<TraceRecord> &records, const std::vector<std::vector<int>> &children, int node, int indent){
+    const TraceRecord &record = records[node];
 
-        if(boards.makeMove(move_list.moves[ind], all) == 0){
-            ply--;
+    printf("%*s%-6s ply %d depth %d [%d, %d] -> %d %s%s%s%s\n", indent * 2, "", traceMoveString(record).c_str(), record.ply, record.depth,
+        record.alpha, record.beta, record.score, trace_reason_names[std::min((int)record.reason, trace_reason_count - 1)],
+        (record.flags & TRACE_QUIESCENCE) ? " qs":"", (record.flags & TRACE_TT_HIT) ? " tt":"", (record.flags & TRACE_EXCLUDED) ? " excluded":"");
 
-            boards.board.rep_ind--;
+    for(int child : children[node]){
+        printTraceNode(records, children, child, indent + 1);
+    }
+}
 
-            continue;
+// Summarises a trace file, or prints one of its subtrees as a tree when subtree is not 0.
+// Nodes are recorded when they return, so a node's children are the nodes one level deeper
+// recorded since the last node at its level.
+void runTraceReader(std::string fileName, unsigned int subtree){
+    TraceHeader header;
+    std::vector<TraceRecord> records;
+
+    if(!readTrace(fileName, header, records)){
+        printf("cannot read trace file %s\n", fileName.c_str());
+        return;
+    }
+
+    std::vector<std::vector<int>> children(records.size());
+
+    // roots of every subtree with their sizes
+    std::vector<std::pair<int, int>> roots;
+
+    // nodes whose parent has not returned yet
+    std::vector<int> open;
+
+    for(int ind = 0; ind < (int)records.size(); ind++){
+        if(!open.empty() && records[open.back()].subtree != records[ind].subtree){
+            open.erase(open.begin(), open.end());
         }
 
-        legal_moves++;
-        // normal alpha beta algo
-        if(moves_searched == 0){ // full depth search
-            score = -negamax(-beta, -alpha, depth - 1, boards);
-        }else{ // Late move reduction
-            // Checks if lmr is possible
-            if((moves_searched >= full_depth_moves) && (depth >= reduction_limit) && (in_check == 0) && ((move_list.moves[ind].flags & CAPTURE) == 0) && (move_list.moves[ind].promotedPiece == P)){
-                score = -negamax(-alpha - 1, -alpha, depth - 2, boards);
-            }else{
-                score = alpha + 1;
+        while(!open.empty() && records[open.back()].level > records[ind].level){
+            children[ind].push_back(open.back());
+            open.pop_back();
+        }
+
+        // popped last child first
+        std::reverse(children[ind].begin(), children[ind].end());
+
+        open.push_back(ind);
+
+        // the first node of a subtree was its root
+        if(ind + 1 == (int)records.size() || records[ind + 1].subtree != records[ind].subtree){
+            int first = ind;
+
+            while(first > 0 && records[first - 1].subtree == records[ind].subtree){
+                first--;
             }
 
-            // principal variation search
-            if(score > alpha){
-                score = -negamax(-alpha - 1, -alpha, depth - 1, boards);
+            roots.push_back({ind, ind - first + 1});
+        }
+    }
+
+    if(subtree){
+        for(std::pair<int, int> root : roots){
+            if(records[root.first].subtree == subtree){
+                printTraceNode(records, children, root.first, 0);
+                return;
+            }
+        }
+
+        printf("subtree %u is not in the trace\n", subtree);
+        return;
+    }
+
+    unsigned long long reasons[trace_reason_count] = {0};
+    unsigned long long ply_nodes[MAX_PLY + 1] = {0};
+    unsigned long long quiescence_nodes = 0, tt_hits = 0;
+
+    for(const TraceRecord &record : records){
+        reasons[std::min((int)record.reason, trace_reason_count - 1)]++;
+        ply_nodes[std::min((int)record.ply, MAX_PLY)]++;
+        quiescence_nodes += (record.flags & TRACE_QUIESCENCE) != 0;
+        tt_hits += (record.flags & TRACE_TT_HIT) != 0;
+    }
+
+    double total = std::max((double)records.size(), 1.0);
+
+    printf("%llu records, %llu dropped, %d subtrees, 1 in %u nodes sampled\n", (unsigned long long)header.count,
+        (unsigned long long)header.dropped, (int)roots.size(), header.sample);
+    printf("negamax %llu, quiescence %llu (%.1f%%), tt hits %.1f%%\n\n", (unsigned long long)records.size() - quiescence_nodes,
+        quiescence_nodes, 100.0 * quiescence_nodes / total, 100.0 * tt_hits / total);
+
+    for(int reason = 1; reason < trace_reason_count; reason++){
+        if(reasons[reason]){
+            printf("%-12s %10llu %5.1f%%\n", trace_reason_names[reason], reasons[reason], 100.0 * reasons[reason] / total);
+        }
+    }
+
+    printf("\nply    nodes\n");
+
+    for(int ply = 0; ply <= MAX_PLY; ply++){
+        if(ply_nodes[ply]){
+            printf("%-3d %8llu\n", ply, ply_nodes[ply]);
+        }
+    }
+
+    std::sort(roots.begin(), roots.end(), [](std::pair<int, int> a, std::pair<int, int> b){
+        return a.second > b.second;
+    });
+
+    printf("\nsubtree    nodes  move   ply depth\n");
+
+    for(int ind = 0; ind < std::min((int)roots.size(), TRACE_TOP_SUBTREES); ind++){
+        const TraceRecord &root = records[roots[ind].first];
+
+        // the oldest subtree may have lost its first nodes to the ring
+        printf("%-8u %7d  %-6s %3d %5d%s\n", root.subtree, roots[ind].second, traceMoveString(root).c_str(), root.ply, root.depth,
+            (header.dropped && root.subtree == records[0].subtree) ? "  incomplete":"");
+    }
+}
+
+/*----------------------------------*/
+/*            COORDINATOR           */
+/*----------------------------------*/
+
+#ifndef _WIN32
+// attempts per position before it is reported as failed, a position that keeps crashing workers is likely bad input
+const int max_batch_attempts = 3;
+
+// a worker that sends nothing for this long is treated as crashed (s)
+const int worker_timeout = 600;
+
+// time a new worker has to build its tables and start listening (ms)
+const int worker_startup_timeout = 5000;
 
-                if((score > alpha) && (score < beta)){
-                    score = -negamax(-beta, -alpha, depth - 1, boards);
-                }
-            }
+// A local engine process in server mode, talked to over a loopback TCP connection
+class WorkerProcess{
+    public:
+    pid_t pid = -1;
+    int fd = -1;
+
+    // unread input from the worker
+    std::string buffer;
+
+    // starts the engine binary as "program server 0 1 <hash MB>" and connects to it, returns false on failure.
+    // The worker binds a port the OS picks and reports it in its banner, so no other process can take it in between.
+    bool start(const char *program, int hash_mb){
+        // the child may only call async-signal-safe functions before exec, another thread may hold the allocator lock
+        std::string hash_arg = std::to_string(hash_mb);
+        int banner[2];
+
+        if(pipe(banner) < 0){
+            return false;
         }
 
-        ply--;
+        // workers started concurrently by other threads must not hold the write end open
+        fcntl(banner[0], F_SETFD, FD_CLOEXEC);
+        fcntl(banner[1], F_SETFD, FD_CLOEXEC);
 
-        boards.board.rep_ind--;
+        pid = fork();
 
-        boards.restoreBoard();
+        if(pid < 0){
+            close(banner[0]);
+            close(banner[1]);
+            return false;
+        }
 
-        // time is up
-        if(stopped){
-            return 0;
+        if(pid == 0){
+            dup2(banner[1], STDOUT_FILENO);
+            execlp(program, program, "server", "0", "1", hash_arg.c_str(), (char *)NULL);
+            _exit(EXIT_FAILURE);
         }
 
-        moves_searched++;
+        close(banner[1]);
 
-        // found a better move
-        if(score > alpha){
-            hashFlag = hashFlagExact;
+        // "listening on <port> with 1 search threads", nothing else is read from the worker's stdout
+        std::string output, line;
+        int port = -1;
+        pollfd ready = {banner[0], POLLIN, 0};
 
-            if((move_list.moves[ind].flags & CAPTURE) == 0){
-                // store history moves
-                history_moves[move_list.moves[ind].piece][move_list.moves[ind].to] += depth;
-            }
+        if(poll(&ready, 1, worker_startup_timeout) > 0 && readSocketLine(banner[0], output, line) && line.compare(0, 13, "listening on ") == 0){
+            port = atoi(line.c_str() + 13);
+        }
 
-            // PV node
-            alpha = score;
+        // later writes to the closed pipe fail quietly, the server ignores SIGPIPE
+        close(banner[0]);
 
-            // PV move
-            pv_table[ply][ply] = move_list.moves[ind];
+        if(port <= 0){
+            stop();
+            return false;
+        }
 
-            for(int next_ply = ply + 1; next_ply < pv_length[ply + 1]; next_ply++){
-                // copy move from deeper ply into current ply's line
-                pv_table[ply][next_ply] = pv_table[ply + 1][next_ply];
-            }
+        fd = socket(AF_INET, SOCK_STREAM, 0);
 
-            pv_length[ply] = pv_length[ply + 1];
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
 
-            // fail hard beta cutoff, node fails high
-            if(score >= beta){
-                storeHashEntry(beta, depth, hashFlagBeta, boards.board.hashKey);
+        if(fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0){
+            stop();
+            return false;
+        }
 
-                if((move_list.moves[ind].flags & CAPTURE) == 0){
-                    // store killer moves
-                    killer_moves[1][ply] = killer_moves[0][ply];
-                    killer_moves[0][ply] = move_list.moves[ind];
-                }
+        timeval timeout = {worker_timeout, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
 
-                return beta;
-            }
-        }
+        return true;
     }
 
-    if(legal_moves == 0){
-        if(in_check){
-            return -mate_value + ply;
-        }else{
-            return 0;
+    // kills the worker, it has no state worth keeping
+    void stop(){
+        if(fd >= 0){
+            close(fd);
+            fd = -1;
+        }
+
+        if(pid > 0){
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+            pid = -1;
         }
+
+        buffer.erase();
     }
 
-    storeHashEntry(alpha, depth, hashFlag, boards.board.hashKey);
+    bool running(){
+        return pid > 0;
+    }
 
-    // node fails low
-    return alpha;
-}
+    bool send(const std::string &text){
+        std::string line = text + "\n";
 
-void searchPosition(int depth, BoardContainer boards){
-    int score;
+        return write(fd, line.data(), line.size()) == (ssize_t)line.size();
+    }
+};
 
-    // reset nodes, and follow PV flags
-    nodes = 0;
-    follow_pv = 0;
-    score_pv = 0;
-    stopped = false;
+// Analyses a file of positions with several worker processes. Every worker starts with a contiguous shard
+// of the positions and steals from the end of the largest remaining shard once its own is empty. Results
+// are appended to the output as they arrive, tagged with their line number in the input.
+class Coordinator{
+    public:
+    // the fen of every input position, its line in the input and how often its analysis failed
+    std::vector<std::string> positions;
+    std::vector<int> lines;
+    std::vector<int> attempts;
 
-    // clear pv, killer, and history
-    memset(killer_moves, 0, sizeof(killer_moves));
-    memset(history_moves, 0, sizeof(history_moves));
-    memset(pv_table, 0, sizeof(pv_table));
-    memset(pv_length, 0, sizeof(pv_length));
-    
-    int alpha = -infinity;
-    int beta = infinity;
+    // position indices still to analyse, one shard per worker
+    std::vector<std::deque<int>> shards;
 
-    // iterative deepening
-    for(int current_depth = 1; current_depth <= depth; current_depth++){        
-        // if time is up
-        if(stopped){
-            break;
-        }
-        
-        // set follow_pv flag
-        follow_pv = 1;
+    std::mutex mutex;
 
-        score = negamax(alpha, beta, current_depth, boards);
+    FILE *output = NULL;
+    const char *program = NULL;
+    int depth = 8;
 
-        if(score <= alpha || score >= beta){
-            alpha = -infinity;
-            beta = infinity;
-            continue;
-        }
+    // hash size of each worker, the same as a thread of EPD analysis
+    int hash_mb = 8;
 
-        alpha = score - 50;
-        beta = score + 50;
+    int analysed = 0;
+    int failed = 0;
 
-        if (score > -mate_value && score < -mate_score){
-            std::cout << "info score mate " << (-(score + mate_value) / 2 - 1) << " depth " << current_depth << " nodes " << nodes << " pv ";
-        }else if (score > mate_score && score < mate_value){
-            std::cout << "info score mate " << ((mate_value - score) / 2 + 1) << " depth " << current_depth << " nodes " << nodes << " pv ";
+    // takes the next position of the worker's shard or steals one, returns false once all work is handed out
+    bool next(int worker, int &index){
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(!shards[worker].empty()){
+            index = shards[worker].front();
+            shards[worker].pop_front();
+            return true;
         }
-        else{
-            std::cout << "info score cp " << score << " depth " << current_depth << " nodes " << nodes << " pv ";
+
+        int victim = -1;
+
+        for(int ind = 0; ind < (int)shards.size(); ind++){
+            if(!shards[ind].empty() && (victim == -1 || shards[ind].size() > shards[victim].size())){
+                victim = ind;
+            }
         }
 
-        for(int count = 0; count < pv_length[0]; count++){
-            pv_table[0][count].print();
-            std::cout << " ";
+        if(victim == -1){
+            return false;
         }
-        std::cout << std::endl;
+
+        index = shards[victim].back();
+        shards[victim].pop_back();
+        return true;
     }
 
-    std::cout << "bestmove ";
-    pv_table[0][0].print();
-    std::cout << std::endl;
-}
+    // puts a position back after its worker crashed, or reports it once it used up its attempts
+    void retry(int worker, int index){
+        std::lock_guard<std::mutex> lock(mutex);
 
-/*----------------------------------*/
-/*                UCI               */
-/*----------------------------------*/
+        if(++attempts[index] < max_batch_attempts){
+            shards[worker].push_front(index);
+            return;
+        }
 
-BoardContainer boardState = BoardContainer();
+        failed++;
+        fprintf(output, "%d\t%s\terror\n", lines[index], positions[index].c_str());
+        fflush(output);
+    }
 
-// Parses a inputted move string given by UCI protocol or user input
-Move parseMove(std::string moveString){
-    MoveList move_list;
+    void report(int index, const std::string &result){
+        std::lock_guard<std::mutex> lock(mutex);
 
-    boardState.board.generateMoves(move_list);
+        analysed++;
+        fprintf(output, "%d\t%s\t%s\n", lines[index], positions[index].c_str(), result.c_str());
+        fflush(output);
+    }
 
-    int from = (moveString[0] - 'a') + (8 - (moveString[1] - '0'))*8;
-    int to = (moveString[2] - 'a') + (8 - (moveString[3] - '0'))*8;
+    // searches one position, result is "bestmove<TAB>score<TAB>depth<TAB>nodes", returns false if the worker failed
+    bool analyse(WorkerProcess &process, int index, std::string &result){
+        std::string line, info;
 
-    for(int ind = 0; ind < move_list.count; ind++){
-        Move move = move_list.moves[ind];
+        // every position starts from empty tables, so its result does not depend on which worker got it or what it searched before
+        if(!process.send("ucinewgame") || !process.send("isready")){
+            return false;
+        }
 
-        if(from == move.from && to == move.to){
-            int promotedPiece = move.promotedPiece;
-        
-            if(promotedPiece){
-                if((promotedPiece == Q || promotedPiece == q) && moveString[4] == 'q'){
-                    return move;
-                }else if((promotedPiece == R || promotedPiece == r) && moveString[4] == 'r'){
-                    return move;
-                }else if((promotedPiece == B || promotedPiece == b) && moveString[4] == 'b'){
-                    return move;
-                }else if((promotedPiece == N || promotedPiece == n) && moveString[4] == 'n'){
-                    return move;
-                }
+        while(line != "readyok"){
+            if(!readSocketLine(process.fd, process.buffer, line)){
+                return false;
+            }
+        }
+
+        if(!process.send("position fen " + positions[index]) || !process.send("go depth " + std::to_string(depth))){
+            return false;
+        }
 
-                // illegal promotion
+        while(readSocketLine(process.fd, process.buffer, line)){
+            if(line.compare(0, 5, "info ") == 0){
+                info = line;
                 continue;
             }
 
-            return move;
-        }
-    }
+            if(line.compare(0, 9, "bestmove ") != 0){
+                continue;
+            }
 
-    return Move();
-}
+            std::istringstream bestmove(line.substr(9));
+            std::string move;
+            bestmove >> move;
+
+            // "info score cp 25 depth 8 nodes 12345 pv ..."
+            std::istringstream fields(info);
+            std::string token, score = "none", reached = "0", nodes = "0";
+
+            while(fields >> token){
+                if(token == "score"){
+                    std::string type, value;
+                    fields >> type >> value;
+                    score = type + " " + value;
+                }else if(token == "depth"){
+                    fields >> reached;
+                }else if(token == "nodes"){
+                    fields >> nodes;
+                }else if(token == "pv"){
+                    break;
+                }
+            }
 
-// Parses a given position string given by UCI protocol or user input
-void parsePosition(std::string command){
-    int ind = 9;
-    if(strncmp(&command[ind], "startpos", 8) == 0){
-        boardState.board = Chessboard(start_position);
-    }else if(strncmp(&command[ind], "fen", 3) == 0){
-        ind += 4;
-        boardState.board = Chessboard(&command[ind]);
-    }else{
-        boardState.board = Chessboard(start_position);
+            result = move + "\t" + score + "\t" + reached + "\t" + nodes;
+            return true;
+        }
+
+        return false;
     }
 
-    ind = command.find("moves");
-    if(ind != -1){
-        ind += 6;
-        
-        while(&command[ind]){
-            Move move = parseMove(&command[ind]);
+    void runWorker(int worker){
+        WorkerProcess process;
+        int index;
 
-            // if illegal
-            if(move.from == no_sq){
-                break;
+        while(next(worker, index)){
+            if(!process.running() && !process.start(program, hash_mb)){
+                // the next attempt starts a fresh process
+                retry(worker, index);
+                continue;
             }
 
-            boardState.board.repetition_table[boardState.board.rep_ind] = boardState.board.hashKey;
-            boardState.board.rep_ind++;
+            std::string result;
 
-            boardState.makeMove(move, all);
-
-            while(&command[ind] && command[ind] != ' '){
-                ind++;
+            if(analyse(process, index, result)){
+                report(index, result);
+            }else{
+                process.stop();
+                retry(worker, index);
             }
-            ind++;
+        }
+
+        if(process.running()){
+            process.send("quit");
+            process.stop();
         }
     }
+};
 
-    boardState.board.printChessboard();
-}
+// analyses every position of input to the given depth with workers engine processes, results go to output
+void runCoordinator(const char *program, std::string input, std::string output, int workers, int depth, int hash_mb){
+    signal(SIGPIPE, SIG_IGN);
 
-// BlueFeverSoftware implementation
-// parse UCI go command
-void parseGo(std::string command)
-{
-    // init parameters
-    int depth = -1;
+    Coordinator coordinator;
+    coordinator.positions = readPositions(input, coordinator.lines);
+    coordinator.attempts.assign(coordinator.positions.size(), 0);
+    coordinator.program = program;
+    coordinator.depth = depth;
+    coordinator.hash_mb = hash_mb;
+    coordinator.output = fopen(output.c_str(), "w");
 
-    // init argument
-    char *argument = NULL;
+    if(coordinator.output == NULL){
+        std::cout << "failed to open " << output << std::endl;
+        return;
+    }
 
-    // infinite search
-    if ((argument = strstr(&command[0],"infinite"))) {}
+    int count = coordinator.positions.size();
+    workers = std::max(1, std::min(workers, count));
 
-    // match UCI "binc" command
-    if ((argument = strstr(&command[0],"binc")) && boardState.board.side == Black){
-        // parse black time increment
-        inc = atoi(argument + 5);
-    }
-    // match UCI "winc" command
-    if ((argument = strstr(&command[0],"winc")) && boardState.board.side == White){
-        // parse white time increment
-        inc = atoi(argument + 5);
-    }
+    // contiguous shards of nearly equal size
+    coordinator.shards.resize(workers);
 
-    // match UCI "wtime" command
-    if ((argument = strstr(&command[0],"wtime")) && boardState.board.side == White){
-        // parse white time limit
-        timeTracker = atoi(argument + 6);
+    for(int index = 0; index < count; index++){
+        coordinator.shards[(long long)index * workers / count].push_back(index);
     }
 
-    // match UCI "btime" command
-    if ((argument = strstr(&command[0],"btime")) && boardState.board.side == Black){
-        // parse black time limit
-        timeTracker = atoi(argument + 6);
-    }
+    int start = get_time_ms();
 
-    // match UCI "movestogo" command
-    if ((argument = strstr(&command[0],"movestogo"))){
-        // parse number of moves to go
-        movestogo = atoi(argument + 10);
-    }
+    std::vector<std::thread> threads;
 
-    // match UCI "movetime" command
-    if ((argument = strstr(&command[0],"movetime"))){
-        // parse amount of time allowed to spend to make a move
-        movetime = atoi(argument + 9);
+    for(int worker = 0; worker < workers; worker++){
+        threads.emplace_back(&Coordinator::runWorker, &coordinator, worker);
     }
 
-    // match UCI "depth" command
-    if ((argument = strstr(&command[0],"depth"))){
-        // parse search depth
-        depth = atoi(argument + 6);
+    for(std::thread &thread : threads){
+        thread.join();
     }
 
-    // if move time is not available
-    if(movetime != -1)
-    {
-        // set time equal to move time
-        timeTracker = movetime;
+    fclose(coordinator.output);
 
-        // set moves to go to 1
-        movestogo = 1;
-    }
+    std::cout << "analysed " << coordinator.analysed << " positions, " << coordinator.failed << " failed, in " << get_time_ms() - start << " ms" << std::endl;
+}
+#endif
 
-    // init start time
-    starttime = get_time_ms();
+/*----------------------------------*/
+/*          INITIALIZATION          */
+/*----------------------------------*/
 
-    // init search depth
-    depth = depth;
+// builds the lookup tables shared by every engine instance, only the first call does any work
+void initTables(){
+    static std::once_flag initialized;
 
-    // if time control is available
-    if(timeTracker != -1)
-    {
-        // flag we're playing with time control
-        timeset = 1;
+    std::call_once(initialized, [](){
+        initLeaperAttacks();
+        initSliderAttacks();
+        init_random_keys();
+        initPawnMasks();
+    });
+}
 
-        // set up timing
-        timeTracker /= movestogo;
-        if(timeTracker > 1500){
-            timeTracker -= 50;
-        }
-        stoptime = starttime + timeTracker + inc;
-    }
+/*----------------------------------*/
+/*              LIBRARY             */
+/*----------------------------------*/
 
-    // if depth is not available
-    if(depth == -1){
-        // set depth to 64 plies (takes ages to complete...)
-        depth = 64;
-    }
+Position::Position(){
+    initTables();
+    boards.reset(new BoardContainer(start_position));
+}
 
-    // print debug info
-    printf("time:%d start:%d stop:%d depth:%d timeset:%d\n",
-    timeTracker, starttime, stoptime, depth, timeset);
+Position::Position(const std::string &fen){
+    initTables();
+    // the parser expects a separator after the castling field
+    boards.reset(new BoardContainer(fen + " "));
+}
 
-    // search position
-    searchPosition(depth, boardState);
+Position::Position(const Position &other){
+    boards.reset(new BoardContainer(*other.boards));
 }
 
-// main UCI program
-void uciLoop(){
-    setbuf(stdin, NULL);
-    setbuf(stdout, NULL);
+Position &Position::operator=(const Position &other){
+    *boards = *other.boards;
+    return *this;
+}
 
-    std::string input;
+Position::~Position(){}
 
-    std::cout << "id name BitboardChessEngine\n";
-    std::cout << "id author CW\n";
-    std::cout << "uciok\n";
+bool Position::play(const std::string &move){
+    MoveList move_list;
 
-    while(1){
-        fflush(stdout);
-        input = "\n\0";
-        getline(std::cin, input);
-        std::cout << "Parsing input: " << input << std::endl;
+    boards->board.generateMoves(move_list);
 
-        if(input[0] == '\n'){
-            continue;
-        }
-        
-        // UCI isready command
-        if(strncmp(&input[0], "isready", 7) == 0){
-            std::cout << "readyok\n";
+    for(int ind = 0; ind < move_list.count; ind++){
+        if(move_list.moves[ind].toString() != move){
             continue;
         }
-        
-        // UCI position command
-        if(strncmp(&input[0], "position", 8) == 0){
-            parsePosition(input);
 
-            clearHashTable();
-            continue;
-        }
+        boards->board.repetition_table[boards->board.rep_ind] = boards->board.hashKey;
+        boards->board.rep_ind++;
 
-        // UCI new game command
-        if(strncmp(&input[0], "ucinewgame", 10) == 0){
-            parsePosition("position startpos");
-            clearHashTable();
-            continue;
+        if(boards->makeMove(move_list.moves[ind], all)){
+            return true;
         }
 
-        // UCI go command
-        if(strncmp(&input[0], "go", 2) == 0){
-            parseGo(input);
-            continue;
-        }
-        
-        // UCI quit command
-        if(strncmp(&input[0], "quit", 4) == 0){
-            break;
-        }
+        boards->board.rep_ind--;
+        return false;
+    }
 
-        // UCI uci command
-        if(strncmp(&input[0], "uci", 3) == 0){
-            std::cout << "id name BitboardChessEngine\n";
-            std::cout << "id author CW\n";
-            std::cout << "uciok\n";
-            continue;
+    return false;
+}
+
+std::vector<std::string> Position::legalMoves() const{
+    MoveList move_list;
+    std::vector<std::string> moves;
+
+    BoardContainer copy = *boards;
+    copy.board.generateMoves(move_list);
+
+    for(int ind = 0; ind < move_list.count; ind++){
+        copy.saveBoard();
+
+        if(copy.makeMove(move_list.moves[ind], all)){
+            moves.push_back(move_list.moves[ind].toString());
+            copy.restoreBoard();
         }
     }
+
+    return moves;
 }
 
-/*----------------------------------*/
-/*          INITIALIZATION          */
-/*----------------------------------*/
+bool Position::whiteToMove() const{
+    return boards->board.side == White;
+}
 
-void init(){
-    initLeaperAttacks();
-    initSliderAttacks();
-    init_random_keys();
-    initPawnMasks();
-    clearHashTable();
+bool Position::inCheck() const{
+    Chessboard &board = boards->board;
+
+    return board.isAttacked(findLSB(board.pieceBoards[board.side == White ? K:k]), getEnemy(board.side));
+}
+
+unsigned long long Position::hashKey() const{
+    return boards->board.hashKey;
+}
+
+int Position::evaluate() const{
+    return ::evaluate(*boards);
+}
+
+Engine::Engine(int hashMegabytes){
+    initTables();
+
+    table.reset(new HashTable());
+    table->allocateHashTable(hashMegabytes);
+
+    searcher.reset(new Searcher(table.get()));
+}
+
+Engine::~Engine(){}
+
+void Engine::setHashSize(int megabytes){
+    table->allocateHashTable(megabytes);
+}
+
+void Engine::setMoveOverhead(int milliseconds){
+    searcher->move_overhead = std::max(0, milliseconds);
+}
+
+void Engine::newGame(){
+    table->clearHashTable();
+    searcher->clearHistory();
+}
+
+SearchResult Engine::search(const Position &position, const SearchLimits &limits, std::function<void(const SearchInfo &)> onInfo){
+    // stopped is cleared when the previous search returns, not here, so a stop() that races with the start is kept
+    searcher->info_callback = onInfo;
+    searcher->setLimits(limits, position.boards->board.side);
+
+    int depth = (limits.depth > 0) ? std::min(limits.depth, MAX_PLY):MAX_PLY;
+
+    SearchResult result = searcher->searchPosition(depth, *position.boards);
+
+    searcher->info_callback = nullptr;
+    searcher->stopped = false;
+
+    return result;
+}
+
+void Engine::stop(){
+    searcher->stopped = true;
+}
+
+void Engine::ponderHit(){
+    searcher->ponderHit();
 }
 
 /*----------------------------------*/
 /*               MAIN               */
 /*----------------------------------*/
 
-int main(){
-    init();
+// hash size of each server session, many sessions share the machine's memory
+#define SERVER_HASH_MB 16
+
+// hash size of each thread in EPD analysis, cleared for every position
+#define BATCH_HASH_MB 8
+
+// defaults of "bench", about ten seconds on one thread
+#define BENCH_DEPTH 6
+#define BENCH_HASH_MB 16
+
+// default repetitions of each micro benchmark
+#define MICRO_REPETITIONS 100
+
+// the library build (make lib) leaves main to the embedding program
+#ifndef CHESS_ENGINE_LIBRARY
+int main(int argc, char *argv[]){
+    initTables();
 
     int debug = 0;
 
+    // "ChessEngine profile bench ..." and "ChessEngine profile perft ..." also report hardware counters
+    bool profile = argc > 1 && strcmp(argv[1], "profile") == 0;
+
+    if(profile){
+        for(int arg = 1; arg + 1 < argc; arg++){
+            argv[arg] = argv[arg + 1];
+        }
+
+        argc--;
+    }
+
     if(debug){
         BoardContainer boards = BoardContainer("6k1/ppppprbp/8/8/8/8/PPPPPRBP/6K1 w - - ");
         boards.board.printChessboard();
         std::cout << "Score: " << evaluate(boards);
+    }else if(argc > 1 && strcmp(argv[1], "server") == 0){
+#ifndef _WIN32
+        // ChessEngine server [port | socket path] [threads] [hash MB per session]
+        std::string address = (argc > 2) ? argv[2]:"9999";
+        int threads = (argc > 3) ? atoi(argv[3]):(int)std::thread::hardware_concurrency();
+        int hash_mb = (argc > 4) ? atoi(argv[4]):SERVER_HASH_MB;
+
+        runServer(address, std::max(threads, 1), hash_mb);
+#else
+        std::cout << "server mode is not supported on this platform" << std::endl;
+#endif
+    }else if(argc > 2 && strcmp(argv[1], "epd") == 0){
+        // ChessEngine epd <file> [depth N] [nodes N] [movetime N] [mate N] [threads N] [hash MB]
+        SearchLimits limits;
+        int threads = std::thread::hardware_concurrency();
+        int hash_mb = BATCH_HASH_MB;
+
+        for(int arg = 3; arg + 1 < argc; arg += 2){
+            if(strcmp(argv[arg], "depth") == 0){
+                limits.depth = atoi(argv[arg + 1]);
+            }else if(strcmp(argv[arg], "nodes") == 0){
+                limits.nodes = strtoull(argv[arg + 1], NULL, 10);
+            }else if(strcmp(argv[arg], "movetime") == 0){
+                limits.movetime = atoi(argv[arg + 1]);
+            }else if(strcmp(argv[arg], "mate") == 0){
+                limits.mate = atoi(argv[arg + 1]);
+            }else if(strcmp(argv[arg], "threads") == 0){
+                threads = atoi(argv[arg + 1]);
+            }else if(strcmp(argv[arg], "hash") == 0){
+                hash_mb = atoi(argv[arg + 1]);
+            }
+        }
+
+        // without a limit every position would be searched to the maximum depth
+        if(limits.depth <= 0 && limits.nodes == 0 && limits.movetime < 0 && limits.mate <= 0){
+            limits.depth = 8;
+        }
+
+        runBatch(argv[2], limits, threads, hash_mb);
+    }else if(argc > 1 && strcmp(argv[1], "bench") == 0){
+        // ChessEngine bench [depth] [threads] [hash MB]
+        int depth = (argc > 2) ? atoi(argv[2]):BENCH_DEPTH;
+        int threads = (argc > 3) ? atoi(argv[3]):1;
+        int hash_mb = (argc > 4) ? atoi(argv[4]):BENCH_HASH_MB;
+
+        runBench(std::max(1, std::min(depth, MAX_PLY)), threads, std::max(hash_mb, 1), profile);
+    }else if(argc > 1 && strcmp(argv[1], "perft") == 0){
+        // ChessEngine perft [depth] [fen]
+        int depth = (argc > 2) ? atoi(argv[2]):perftDepth;
+        std::string fen = start_position;
+
+        if(argc > 3){
+            fen.erase();
+
+            for(int arg = 3; arg < argc; arg++){
+                fen += std::string(argv[arg]) + " ";
+            }
+        }
+
+        // node_count has one slot per depth
+        runPerft(std::max(0, std::min(depth, perftDepth)), fen, profile);
+    }else if(argc > 1 && strcmp(argv[1], "microbench") == 0){
+        // ChessEngine microbench [repetitions]
+        int repetitions = (argc > 2) ? atoi(argv[2]):MICRO_REPETITIONS;
+
+        runMicroBench(std::max(repetitions, 1));
+    }else if(argc > 2 && strcmp(argv[1], "trace") == 0){
+        // ChessEngine trace <file> [subtree]
+        runTraceReader(argv[2], (argc > 3) ? strtoul(argv[3], NULL, 10):0);
+    }else if(argc > 1 && strcmp(argv[1], "coordinate") == 0){
+#ifndef _WIN32
+        // ChessEngine coordinate <positions file> <results file> [workers] [depth]
+        if(argc < 4){
+            std::cout << "usage: " << argv[0] << " coordinate <positions file> <results file> [workers] [depth]" << std::endl;
+            return 1;
+        }
+
+        int workers = (argc > 4) ? atoi(argv[4]):(int)std::thread::hardware_concurrency();
+        int depth = (argc > 5) ? atoi(argv[5]):8;
+
+        runCoordinator(argv[0], argv[2], argv[3], workers, std::max(depth, 1), BATCH_HASH_MB);
+#else
+        std::cout << "coordinator mode is not supported on this platform" << std::endl;
+#endif
     }else{
         uciLoop();
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
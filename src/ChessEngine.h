@@ -0,0 +1,157 @@
+#ifndef CHESS_ENGINE_H
+#define CHESS_ENGINE_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*----------------------------------*/
+/*            LIBRARY API           */
+/*----------------------------------*/
+
+// In-process interface to the engine, built with "make lib". Every Engine owns its transposition table
+// and search state, so separate engines may search concurrently on separate threads. The attack tables
+// and zobrist keys are built by the first Engine or Position and shared read-only afterwards.
+// Moves are in UCI notation (e2e4, e7e8q).
+
+class BoardContainer;
+class HashTable;
+class Searcher;
+
+// A position and the positions leading to it, used for repetition detection
+class Position{
+    public:
+    // starting position
+    Position();
+    // position from a FEN string
+    explicit Position(const std::string &fen);
+
+    Position(const Position &other);
+    Position &operator=(const Position &other);
+    ~Position();
+
+    // plays a move, returns false and leaves the position unchanged if it is not legal
+    bool play(const std::string &move);
+
+    std::vector<std::string> legalMoves() const;
+
+    bool whiteToMove() const;
+    bool inCheck() const;
+
+    // zobrist key of the position
+    unsigned long long hashKey() const;
+
+    // static evaluation in centipawns from the side to move's point of view
+    int evaluate() const;
+
+    private:
+    std::unique_ptr<BoardContainer> boards;
+
+    friend class Engine;
+};
+
+// Limits of a single search, fields left at their defaults do not restrict it
+class SearchLimits{
+    public:
+    // maximum depth in plies, 0 for no limit
+    int depth = 0;
+
+    // fixed time for the move in ms, -1 if not set
+    int movetime = -1;
+
+    // stop after about this many nodes, 0 for no limit
+    unsigned long long nodes = 0;
+
+    // looks only for a mate in at most this many moves with the proof-number solver, 0 for a normal search
+    int mate = 0;
+
+    // remaining clock times and increments in ms, the engine uses those of the side to move
+    int wtime = -1, btime = -1;
+    int winc = 0, binc = 0;
+
+    // moves until the next time control, 0 if unknown
+    int movestogo = 0;
+
+    // search on the opponent's time, the clock only starts with Engine::ponderHit
+    bool ponder = false;
+
+    // restricts the root to these moves, empty to search every legal move
+    std::vector<std::string> searchmoves;
+
+    // number of best root moves to find, each with its own score and pv
+    int multipv = 1;
+};
+
+// Result of a completed iteration, one per line with MultiPV
+class SearchInfo{
+    public:
+    // rank of the line, 1 for the best move
+    int multipv = 1;
+
+    int depth = 0;
+
+    // centipawns from the side to move's point of view
+    int score = 0;
+
+    // moves to mate, negative if the side to move is mated, 0 if no mate was found
+    int mate = 0;
+
+    unsigned long long nodes = 0;
+
+    // ms since the search started
+    int time = 0;
+
+    // permill of the transposition table written during this search
+    int hashfull = 0;
+
+    std::vector<std::string> pv;
+};
+
+// Result of a search, the fields of SearchInfo describe the last completed iteration
+class SearchResult : public SearchInfo{
+    public:
+    // empty if the position has no legal move
+    std::string bestMove;
+
+    // expected reply to bestMove, empty if the pv is a single move
+    std::string ponderMove;
+
+    // every line of the last completed iteration, best first
+    std::vector<SearchInfo> lines;
+};
+
+class Engine{
+    public:
+    explicit Engine(int hashMegabytes = 16);
+
+    Engine(const Engine &) = delete;
+    Engine &operator=(const Engine &) = delete;
+
+    ~Engine();
+
+    // resizes the transposition table, which also clears it,
+    // throws std::bad_alloc and keeps the current table if the new size cannot be allocated
+    void setHashSize(int megabytes);
+
+    // ms reserved per move for communication latency
+    void setMoveOverhead(int milliseconds);
+
+    // forgets the transposition table and move ordering statistics of earlier searches
+    void newGame();
+
+    // searches on the calling thread until a limit is reached or stop() is called,
+    // onInfo is called on the same thread after every completed iteration
+    SearchResult search(const Position &position, const SearchLimits &limits, std::function<void(const SearchInfo &)> onInfo = nullptr);
+
+    // may be called from any thread, ends the running search or, if none is running,
+    // makes the next search() return right away with a legal move
+    void stop();
+    void ponderHit();
+
+    private:
+    std::unique_ptr<HashTable> table;
+    std::unique_ptr<Searcher> searcher;
+};
+
+#endif